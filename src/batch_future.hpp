@@ -0,0 +1,283 @@
+#pragma once
+
+#include "future.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+namespace hntr::platform {
+
+template <typename T, typename E> class batch_promise;
+template <typename T, typename E> class batch_future;
+
+namespace details {
+
+// Called for each slot of a batch as it completes.
+template <typename T, typename E>
+class batch_callback {
+public:
+    virtual ~batch_callback() = default;
+    virtual void operator()(std::size_t index, expected<T, E> const& value) = 0;
+};
+
+template <typename F, typename T, typename E>
+class batch_callback_of final : public batch_callback<T, E> {
+public:
+    template <typename FF>
+    explicit batch_callback_of(FF&& f) : _f(std::forward<FF>(f)) {}
+
+    void operator()(std::size_t index, expected<T, E> const& value) override {
+        _f(index, value);
+    }
+
+private:
+    F _f;
+};
+
+// State shared by the N slots of a batch. It is one allocation: this header,
+// then two bitmaps, then the slots themselves, an array of expected<T, E>
+// constructed as each slot completes. One counter counts down the slots left;
+// the producer completing the last one publishes the whole array as the value
+// of the state, so the all-done continuation is an ordinary future's.
+//
+// A per-slot callback may be attached at any time. A slot is reported once,
+// either by its producer, if the callback is there by the time the slot is
+// filled, or by the consumer attaching it, which replays the slots filled
+// before; whichever claims the slot's `notified` bit first calls it.
+template <typename T, typename E>
+class batch_state final : public precursor<std::span<expected<T, E> const>, E> {
+public:
+    using slot_type = expected<T, E>;
+    using result_type = std::span<slot_type const>;
+
+    static intrusive_ptr<batch_state> create(std::size_t size) {
+        void* memory = over_aligned()
+                ? ::operator new(bytes(size), std::align_val_t(alignment()))
+                : ::operator new(bytes(size));
+        return intrusive_ptr<batch_state>(::new (memory) batch_state(size));
+    }
+
+    std::size_t size() const noexcept {
+        return _size;
+    }
+
+    void fill(std::size_t index, slot_type&& value) {
+        assert(index < _size && !filled(index));
+        std::construct_at(slots() + index, std::move(value));
+        filled_bits()[index / 64].fetch_or(bit(index), std::memory_order_seq_cst);
+        if (_each.load(std::memory_order_seq_cst)) {
+            notify(index);
+        }
+        if (_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            this->set_value(expected<result_type, E>(result_type(slots(), _size)));
+        }
+    }
+
+    slot_type const* try_get(std::size_t index) const noexcept {
+        return filled(index) ? slots() + index : nullptr;
+    }
+
+    void attach_each(batch_callback<T, E>* callback) {
+        assert(!_each.load(std::memory_order_relaxed));
+        _each.store(callback, std::memory_order_seq_cst);
+        for (std::size_t i = 0; i < _size; ++i) {
+            if (filled(i)) {
+                notify(i);
+            }
+        }
+    }
+
+protected:
+    void destroy() noexcept override {
+        const auto size = _size;
+        this->~batch_state();
+        if constexpr (over_aligned()) {
+            ::operator delete(this, bytes(size), std::align_val_t(alignment()));
+        } else {
+            ::operator delete(this, bytes(size));
+        }
+    }
+
+private:
+    static constexpr std::size_t alignment() noexcept {
+        return std::max(alignof(batch_state), alignof(slot_type));
+    }
+
+    static constexpr bool over_aligned() noexcept {
+        return alignment() > __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+    }
+
+    explicit batch_state(std::size_t size) : _size(size), _pending(size) {
+        for (std::size_t w = 0; w < 2 * words(size); ++w) {
+            ::new (static_cast<void*>(bitmaps() + w)) std::atomic<std::uint64_t>(0);
+        }
+        if (size == 0) {
+            this->set_value(expected<result_type, E>(result_type()));
+        }
+    }
+
+    ~batch_state() {
+        for (std::size_t i = 0; i < _size; ++i) {
+            if (filled(i)) {
+                std::destroy_at(slots() + i);
+            }
+        }
+        delete _each.load(std::memory_order_relaxed);
+    }
+
+    static std::size_t words(std::size_t size) noexcept {
+        return (size + 63) / 64;
+    }
+
+    static std::size_t bitmaps_offset() noexcept {
+        return (sizeof(batch_state) + alignof(std::uint64_t) - 1) / alignof(std::uint64_t) * alignof(std::uint64_t);
+    }
+
+    static std::size_t slots_offset(std::size_t size) noexcept {
+        const auto end = bitmaps_offset() + 2 * words(size) * sizeof(std::uint64_t);
+        return (end + alignof(slot_type) - 1) / alignof(slot_type) * alignof(slot_type);
+    }
+
+    static std::size_t bytes(std::size_t size) noexcept {
+        return slots_offset(size) + size * sizeof(slot_type);
+    }
+
+    static std::uint64_t bit(std::size_t index) noexcept {
+        return std::uint64_t(1) << (index % 64);
+    }
+
+    std::atomic<std::uint64_t>* bitmaps() const noexcept {
+        auto* base = reinterpret_cast<unsigned char*>(const_cast<batch_state*>(this));
+        return std::launder(reinterpret_cast<std::atomic<std::uint64_t>*>(base + bitmaps_offset()));
+    }
+
+    std::atomic<std::uint64_t>* filled_bits() const noexcept {
+        return bitmaps();
+    }
+
+    std::atomic<std::uint64_t>* notified_bits() const noexcept {
+        return bitmaps() + words(_size);
+    }
+
+    slot_type* slots() const noexcept {
+        auto* base = reinterpret_cast<unsigned char*>(const_cast<batch_state*>(this));
+        return reinterpret_cast<slot_type*>(base + slots_offset(_size));
+    }
+
+    bool filled(std::size_t index) const noexcept {
+        return filled_bits()[index / 64].load(std::memory_order_seq_cst) & bit(index);
+    }
+
+    void notify(std::size_t index) {
+        if (!(notified_bits()[index / 64].fetch_or(bit(index), std::memory_order_acq_rel) & bit(index))) {
+            (*_each.load(std::memory_order_acquire))(index, slots()[index]);
+        }
+    }
+
+    std::size_t _size;
+    std::atomic<std::size_t> _pending;
+    std::atomic<batch_callback<T, E>*> _each{nullptr};
+};
+
+} // namespace details
+
+// Producer side of a batch: N results of one type sharing one allocation and
+// one completion counter, for fan-outs too wide for a promise per result.
+// Each slot is completed once, by index, from any thread; a slot costs the
+// size of its expected plus two bits. Producers may share the batch_promise
+// by reference.
+template <typename T, typename E = std::exception_ptr>
+class batch_promise {
+public:
+    explicit batch_promise(std::size_t size) : _state(details::batch_state<T, E>::create(size)) {}
+
+    batch_promise(batch_promise&& o) = default;
+
+    std::size_t size() const noexcept {
+        return _state->size();
+    }
+
+    template <typename... Args>
+    void set_value(std::size_t index, Args&&... args) {
+        _state->fill(index, expected<T, E>(std::forward<Args>(args)...));
+    }
+
+    // As promise::set_exception(): exceptions are captured into an
+    // exception_ptr, anything else is converted to E.
+    template <typename EE = E>
+    void set_exception(std::size_t index, EE&& e) {
+        if constexpr (std::is_base_of_v<std::exception, std::decay_t<EE>> && std::is_same_v<std::exception_ptr, E>) {
+            _state->fill(index, expected<T, E>(unexpected(std::make_exception_ptr(std::forward<EE>(e)))));
+        } else {
+            _state->fill(index, expected<T, E>(unexpected<E>(E(std::forward<EE>(e)))));
+        }
+    }
+
+    batch_future<T, E> get_future() {
+        return batch_future<T, E>(_state);
+    }
+
+private:
+    details::intrusive_ptr<details::batch_state<T, E>> _state;
+};
+
+// Consumer side of a batch. Slots can be read one by one as they complete,
+// reported through one per-slot callback, or all at once: done() is an
+// ordinary future completing with a span over every slot, in slot order,
+// which then(), pipe() and co_await chain from as usual. The span points into
+// the batch and stays valid while a batch_future or the batch_promise is
+// alive.
+template <typename T, typename E = std::exception_ptr>
+class batch_future {
+public:
+    using result_type = std::span<expected<T, E> const>;
+
+    explicit batch_future() {}
+
+    std::size_t size() const noexcept {
+        return _state->size();
+    }
+
+    bool is_ready() const noexcept {
+        return _state && !!*_state;
+    }
+
+    // The slot if it has completed, without waiting.
+    expected<T, E> const* try_get(std::size_t index) const noexcept {
+        return _state->try_get(index);
+    }
+
+    // Waits for every slot.
+    result_type get() const {
+        return *std::as_const(*_state).get();
+    }
+
+    future<result_type, E> done() const {
+        return future<result_type, E>(_state);
+    }
+
+    // Calls `f(index, result)` once for every slot, on the thread completing
+    // it, or right away for slots completed already. Only one callback may be
+    // attached to a batch.
+    template <typename F>
+    void on_each(F&& f) const {
+        _state->attach_each(new details::batch_callback_of<std::decay_t<F>, T, E>(std::forward<F>(f)));
+    }
+
+private:
+    friend class batch_promise<T, E>;
+
+    explicit batch_future(details::intrusive_ptr<details::batch_state<T, E>> state) : _state(std::move(state)) {}
+
+    details::intrusive_ptr<details::batch_state<T, E>> _state;
+};
+
+}
@@ -0,0 +1,264 @@
+#pragma once
+
+#include "future.hpp"
+
+#include <atomic>
+#include <exception>
+#include <stdexcept>
+#include <stop_token>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+namespace hntr::platform {
+
+// Error a cancelled stage completes with when E is std::exception_ptr.
+class operation_cancelled : public std::runtime_error {
+public:
+    operation_cancelled() : std::runtime_error("operation cancelled") {}
+};
+
+namespace details {
+
+// The error a cancelled stage completes with: operation_cancelled for
+// std::exception_ptr, std::errc::operation_canceled for std::error_code, and
+// for any other E whatever it makes of that errc.
+template <typename E>
+E cancellation_error() {
+    if constexpr (std::is_same_v<std::exception_ptr, E>) {
+        return std::make_exception_ptr(operation_cancelled());
+    } else if constexpr (std::is_same_v<std::error_code, E>) {
+        return std::make_error_code(std::errc::operation_canceled);
+    } else {
+        static_assert(std::is_constructible_v<E, std::errc>, "E has no way to express cancellation");
+        return E(std::errc::operation_canceled);
+    }
+}
+
+// Handler whose captures can be destroyed before the link holding it is.
+template <typename F>
+class droppable {
+public:
+    explicit droppable(F&& f) : _f(std::move(f)) {}
+    explicit droppable(F const& f) : _f(f) {}
+    droppable(droppable&& o) : _f(std::move(*o._f)) {}
+    droppable(droppable const& o) : _f(*o._f) {}
+
+    template <typename... Args>
+    decltype(auto) operator()(Args&&... args) {
+        return (*_f)(std::forward<Args>(args)...);
+    }
+
+    void drop() {
+        _f.reset();
+    }
+
+private:
+    optional<F> _f;
+};
+
+// Cancellation shared by inline and scheduled links. A stage runs at most
+// once: either the value path claims it and runs the handler, or the stop
+// callback claims it, destroys the handler with everything it captured and
+// completes the stage with the cancellation error, which carries on down the
+// chain like any other error.
+//
+// The stop callback is the last member, so it is deregistered first when the
+// link dies; deregistration waits for a callback running on another thread,
+// which keeps the rest of the link alive for as long as the callback needs it.
+template <typename Base, typename O, typename E>
+class cancellable_stage : public Base {
+public:
+    template <typename... Args>
+    explicit cancellable_stage(std::stop_token const& token, Args&&... args)
+        : Base(std::forward<Args>(args)...)
+        , _on_stop(token, stopper{this})
+    {}
+
+protected:
+    bool claim() noexcept {
+        return !_claimed.exchange(true, std::memory_order_acq_rel);
+    }
+
+    bool claimed() const noexcept {
+        return _claimed.load(std::memory_order_acquire);
+    }
+
+private:
+    struct stopper {
+        cancellable_stage* self;
+
+        void operator()() noexcept {
+            self->cancel();
+        }
+    };
+
+    void cancel() noexcept {
+        if (claim()) {
+            this->_handler.drop();
+            precursor<O, E>::set_value_unowned(unexpected(cancellation_error<E>()));
+        }
+    }
+
+    std::atomic<bool> _claimed{false};
+    std::stop_callback<stopper> _on_stop;
+};
+
+template <typename Handler_t, typename I, typename O, typename E>
+class cancellable_link : public cancellable_stage<link<Handler_t, I, O, E>, O, E> {
+public:
+    using cancellable_stage<link<Handler_t, I, O, E>, O, E>::cancellable_stage;
+
+    void handle(expected<I, E> const& value) {
+        if (this->claim()) {
+            link<Handler_t, I, O, E>::handle(value);
+        } else {
+            this->release();
+        }
+    }
+
+    void handle(expected<I, E> && value) {
+        if (this->claim()) {
+            link<Handler_t, I, O, E>::handle(std::move(value));
+        } else {
+            this->release();
+        }
+    }
+};
+
+// Claims on the executor rather than on arrival, so a stage cancelled while it
+// sits in a queue does not run its handler when it is eventually dequeued.
+template <typename Handler_t, typename I, typename O, typename E>
+class cancellable_scheduled_link : public cancellable_stage<scheduled_link<Handler_t, I, O, E>, O, E> {
+public:
+    using cancellable_stage<scheduled_link<Handler_t, I, O, E>, O, E>::cancellable_stage;
+
+    void handle(expected<I, E> const& value) {
+        if (this->claimed()) {
+            this->release();
+        } else {
+            scheduled_link<Handler_t, I, O, E>::handle(value);
+        }
+    }
+
+    void handle(expected<I, E> && value) {
+        if (this->claimed()) {
+            this->release();
+        } else {
+            scheduled_link<Handler_t, I, O, E>::handle(std::move(value));
+        }
+    }
+
+    void run() override {
+        if (this->claim()) {
+            scheduled_link<Handler_t, I, O, E>::run();
+        } else {
+            this->release();
+        }
+    }
+};
+
+} // namespace details
+
+// Future whose then() chain can be abandoned. Every future derived from it
+// through then() shares its stop source, and cancel() on any of them:
+//  - completes each stage that has not started yet with the cancellation
+//    error, without running its handler;
+//  - destroys those handlers, and with them their captures, right away;
+//  - signals the stop token, which producers poll or subscribe to with
+//    std::stop_callback so they can give up on work nobody is waiting for.
+// A stage already running finishes normally. The future the chain was started
+// from completes only when its producer completes it.
+template <typename T, typename E>
+class cancellable_future : public future<T, E> {
+public:
+    explicit cancellable_future() {}
+
+    explicit cancellable_future(future<T, E> f, std::stop_source stop = std::stop_source())
+        : future<T, E>(std::move(f))
+        , _stop(std::move(stop))
+    {}
+
+    std::stop_token get_stop_token() const noexcept {
+        return _stop.get_token();
+    }
+
+    std::stop_source get_stop_source() const noexcept {
+        return _stop;
+    }
+
+    // Returns false if the chain had already been cancelled.
+    bool cancel() noexcept {
+        return _stop.request_stop();
+    }
+
+    bool cancelled() const noexcept {
+        return _stop.stop_requested();
+    }
+
+    cancellable_future& via(Executor& executor, schedule policy = schedule::post) & {
+        future<T, E>::via(executor, policy);
+        return *this;
+    }
+
+    cancellable_future&& via(Executor& executor, schedule policy = schedule::post) && {
+        return std::move(via(executor, policy));
+    }
+
+    // The fused stages are cancelled together, as one.
+    pipeline<cancellable_future, details::identity> pipe() const& {
+        return pipeline<cancellable_future, details::identity>(cancellable_future(*this), details::identity());
+    }
+
+    pipeline<cancellable_future, details::identity> pipe() && {
+        return pipeline<cancellable_future, details::identity>(std::move(*this), details::identity());
+    }
+
+    template<typename F, typename R = typename details::resolver<F, T, E>::return_type>
+    cancellable_future<R, E> then(F&& handler) & {
+        return then_impl(std::forward<F>(handler), false);
+    }
+
+    template<typename F, typename R = typename details::resolver<F, T, E>::return_type>
+    cancellable_future<R, E> then(F&& handler) && {
+        return then_impl(std::forward<F>(handler), true);
+    }
+
+    template<typename F, typename R = typename details::resolver<F, T, E>::return_type>
+    cancellable_future<R, E> then(Executor& executor, F&& handler) & {
+        return then_impl(executor, std::forward<F>(handler), false);
+    }
+
+    template<typename F, typename R = typename details::resolver<F, T, E>::return_type>
+    cancellable_future<R, E> then(Executor& executor, F&& handler) && {
+        return then_impl(executor, std::forward<F>(handler), true);
+    }
+
+private:
+    template<typename F, typename R = typename details::resolver<F, T, E>::return_type>
+    cancellable_future<R, E> then_impl(F&& handler, bool consume) {
+        if (this->_executor) {
+            return then_impl(*this->_executor, std::forward<F>(handler), consume);
+        }
+        using handler_type = details::droppable<std::decay_t<F>>;
+        auto cont = details::allocate_intrusive<details::cancellable_link<handler_type, T, R, E>>(
+                this->_value->resource(), _stop.get_token(), handler_type(std::forward<F>(handler)));
+        cont->add_ref();
+        this->_value->set_continuation(cont.get(), consume);
+        return cancellable_future<R, E>(this->inherit(future<R, E>(std::move(cont))), _stop);
+    }
+
+    template<typename F, typename R = typename details::resolver<F, T, E>::return_type>
+    cancellable_future<R, E> then_impl(Executor& executor, F&& handler, bool consume) {
+        using handler_type = details::droppable<std::decay_t<F>>;
+        auto cont = details::allocate_intrusive<details::cancellable_scheduled_link<handler_type, T, R, E>>(
+                this->_value->resource(), _stop.get_token(), handler_type(std::forward<F>(handler)), executor, this->_policy);
+        cont->add_ref();
+        this->_value->set_continuation(cont.get(), consume);
+        return cancellable_future<R, E>(this->inherit(future<R, E>(std::move(cont))), _stop);
+    }
+
+    std::stop_source _stop;
+};
+
+}
@@ -1,11 +1,146 @@
 #pragma once
 
+#include <type_traits>
+#include <utility>
+
 namespace hntr::platform {
 
+// Unit of work accepted by an executor. Tasks are intrusive so that executors
+// can queue them without allocating: a continuation submits itself. run()
+// executes the work and disposes of the task; the executor never touches a
+// task after calling run().
+class task {
+public:
+    virtual void run() = 0;
+
+    // Intrusive link for executors that keep tasks in lists.
+    task* next = nullptr;
+
+protected:
+    ~task() = default;
+};
+
+// How a continuation is handed to its executor.
+//  post     - always queued, never run by the submitting thread;
+//  defer    - queued as a continuation of the submitter's current work, which
+//             lets an executor keep it local to the submitting thread;
+//  dispatch - run inline when the submitter is already on the executor,
+//             queued otherwise.
+enum class schedule { post, defer, dispatch };
+
+namespace details {
+
+template <typename F>
+class function_task final : public task {
+public:
+    explicit function_task(F&& f) : _f(std::move(f)) {}
+    explicit function_task(F const& f) : _f(f) {}
+
+    void run() override {
+        _f();
+        delete this;
+    }
+
+private:
+    F _f;
+};
+
+} // namespace details
+
 class Executor {
 public:
+    virtual ~Executor() = default;
+
+    virtual void post(task& t) = 0;
+
+    virtual void defer(task& t) {
+        post(t);
+    }
+
+    virtual void dispatch(task& t) {
+        if (running_in_this_thread()) {
+            t.run();
+        } else {
+            post(t);
+        }
+    }
+
+    // True when called from a thread currently running work of this executor.
+    virtual bool running_in_this_thread() const {
+        return false;
+    }
+
+    void submit(task& t, schedule policy) {
+        switch (policy) {
+        case schedule::post: post(t); break;
+        case schedule::defer: defer(t); break;
+        case schedule::dispatch: dispatch(t); break;
+        }
+    }
+};
+
+// Runs everything immediately on the submitting thread.
+class inline_executor final : public Executor {
+public:
+    void post(task& t) override {
+        t.run();
+    }
+
+    bool running_in_this_thread() const override {
+        return true;
+    }
+};
+
+// Marks the calling thread as running work of `executor` while it lives.
+// Executors that run tasks on threads of their own hold one around them, so
+// that work which cannot run where it is, such as a continuation past the
+// inline depth, finds its way back to them. An inline_executor would run that
+// work right where it is, so under one the thread runs no executor's work.
+class executor_scope {
+public:
+    explicit executor_scope(Executor& executor) noexcept
+        : _previous(std::exchange(_current, dynamic_cast<inline_executor*>(&executor) ? nullptr : &executor))
+    {}
+
+    executor_scope(executor_scope const&) = delete;
+    executor_scope& operator= (executor_scope const&) = delete;
 
+    ~executor_scope() {
+        _current = _previous;
+    }
+
+    static Executor* current() noexcept {
+        return _current;
+    }
+
+private:
+    Executor* _previous;
+    static inline thread_local Executor* _current = nullptr;
 };
 
+// The executor whose work the calling thread is running, or null.
+inline Executor* current_executor() noexcept {
+    return executor_scope::current();
 }
 
+// Submission of plain callables; each wraps the callable into a heap task.
+template <typename F>
+void post(Executor& executor, F&& f) {
+    executor.post(*new details::function_task<std::decay_t<F>>(std::forward<F>(f)));
+}
+
+template <typename F>
+void defer(Executor& executor, F&& f) {
+    executor.defer(*new details::function_task<std::decay_t<F>>(std::forward<F>(f)));
+}
+
+template <typename F>
+void dispatch(Executor& executor, F&& f) {
+    if (executor.running_in_this_thread()) {
+        f();
+    } else {
+        post(executor, std::forward<F>(f));
+    }
+}
+
+}
@@ -2,154 +2,282 @@
 
 #include <string>
 #include <iostream>
+#include <cassert>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <type_traits>
+
+#include "niche.hpp"
 
 namespace hntr::platform {
 
 template<typename T, typename E> class expected;
 
+namespace details {
+
+// Reports access to the value of a failed expected: the error is thrown, or
+// rethrown if it is an exception_ptr. Built without exceptions there is
+// nobody to report it to, so it is fatal.
+template <typename E>
+[[noreturn]] void bad_expected_access(E const& error) {
+#if defined(__cpp_exceptions)
+    if constexpr (std::is_same<std::exception_ptr, E>::value) {
+        std::rethrow_exception(error);
+    } else {
+        throw error;
+    }
+#else
+    (void)error;
+    std::abort();
+#endif
+}
+
+} // namespace details
+
 template <typename E>
 class unexpected {
 public:
-    unexpected(E&& e) : error(std::forward<E>(e)) {}
-    unexpected(E const& e) : error(e) {}
+    constexpr unexpected(E&& e) : error(std::forward<E>(e)) {}
+    constexpr unexpected(E const& e) : error(e) {}
 
 private: 
     template<typename, typename> friend class expected;
     E error;
 };
 
-template<typename T, typename E>
-class expected {
+namespace details {
+
+template <typename> struct is_expected_type : std::false_type {};
+template <typename T, typename E> struct is_expected_type<expected<T, E>> : std::true_type {
+    using value_type = T;
+    using error_type = E;
+};
+
+// Composition shared by every layout of expected. Each combinator takes the
+// expected by reference; called on an rvalue it moves the value or error out
+// rather than copying it. Nothing is allocated and, the handlers being known,
+// everything inlines down to the branch one would have written by hand.
+//   and_then(f)        - f(value) returns the next expected; errors pass by.
+//   transform(f)       - f(value) returns the next value; errors pass by.
+//   or_else(f)         - f(error) returns a recovered expected; values pass by.
+//   transform_error(f) - f(error) returns a different error; values pass by.
+template <typename Self, typename T, typename E>
+class expected_operations {
 public:
-    typedef expected<T, E> type;
+    template <typename F> constexpr auto and_then(F&& f) & { return and_then_impl(self(), std::forward<F>(f)); }
+    template <typename F> constexpr auto and_then(F&& f) const& { return and_then_impl(self(), std::forward<F>(f)); }
+    template <typename F> constexpr auto and_then(F&& f) && { return and_then_impl(std::move(self()), std::forward<F>(f)); }
+
+    template <typename F> constexpr auto transform(F&& f) & { return transform_impl(self(), std::forward<F>(f)); }
+    template <typename F> constexpr auto transform(F&& f) const& { return transform_impl(self(), std::forward<F>(f)); }
+    template <typename F> constexpr auto transform(F&& f) && { return transform_impl(std::move(self()), std::forward<F>(f)); }
+
+    template <typename F> constexpr auto or_else(F&& f) & { return or_else_impl(self(), std::forward<F>(f)); }
+    template <typename F> constexpr auto or_else(F&& f) const& { return or_else_impl(self(), std::forward<F>(f)); }
+    template <typename F> constexpr auto or_else(F&& f) && { return or_else_impl(std::move(self()), std::forward<F>(f)); }
+
+    template <typename F> constexpr auto transform_error(F&& f) & { return transform_error_impl(self(), std::forward<F>(f)); }
+    template <typename F> constexpr auto transform_error(F&& f) const& { return transform_error_impl(self(), std::forward<F>(f)); }
+    template <typename F> constexpr auto transform_error(F&& f) && { return transform_error_impl(std::move(self()), std::forward<F>(f)); }
 
-    explicit expected() { new(&_value) T(); }
-    explicit expected(T const& v) { new (&_value) T(v); }
-    template<class TT = T> explicit expected(T&& v) noexcept {
-        new (&_value) T(std::forward<TT>(v));
+private:
+    constexpr Self& self() { return static_cast<Self&>(*this); }
+    constexpr Self const& self() const { return static_cast<Self const&>(*this); }
+
+    // The value of `s` as the handler receives it; nothing for void.
+    template <typename S, typename F>
+    static constexpr decltype(auto) with_value(S&& s, F&& f) {
+        if constexpr (std::is_void_v<T>) {
+            return std::invoke(std::forward<F>(f));
+        } else {
+            return std::invoke(std::forward<F>(f), std::forward<S>(s).value());
+        }
     }
 
-    expected(expected const& v) : ok(v.ok) {
-        if (ok) new(&_value) T(v.value());
-        else new(&_error) E(v.error());
+    template <typename S, typename F>
+    static constexpr auto and_then_impl(S&& s, F&& f) {
+        using R = std::remove_cvref_t<decltype(with_value(std::forward<S>(s), std::forward<F>(f)))>;
+        static_assert(is_expected_type<R>::value, "and_then() handlers return an expected");
+        static_assert(std::is_same_v<typename is_expected_type<R>::error_type, E>, "and_then() cannot change the error type");
+        if (!s) {
+            return R(unexpected<E>(std::forward<S>(s).error()));
+        }
+        return R(with_value(std::forward<S>(s), std::forward<F>(f)));
     }
 
-    expected(expected && v) : ok(v.ok) {
-        if (ok) new(&_value) T(std::move(v.value()));
-        else new(&_error) E(std::move(v.error()));
+    template <typename S, typename F>
+    static constexpr auto transform_impl(S&& s, F&& f) {
+        using U = std::remove_cvref_t<decltype(with_value(std::forward<S>(s), std::forward<F>(f)))>;
+        if (!s) {
+            return expected<U, E>(unexpected<E>(std::forward<S>(s).error()));
+        }
+        if constexpr (std::is_void_v<U>) {
+            with_value(std::forward<S>(s), std::forward<F>(f));
+            return expected<U, E>();
+        } else {
+            return expected<U, E>(with_value(std::forward<S>(s), std::forward<F>(f)));
+        }
     }
 
-    expected(unexpected<E> const& e) : ok(false) {
-        new(&_error) E(e.error);
+    template <typename S, typename F>
+    static constexpr auto or_else_impl(S&& s, F&& f) {
+        using R = std::remove_cvref_t<std::invoke_result_t<F, decltype(std::forward<S>(s).error())>>;
+        static_assert(is_expected_type<R>::value, "or_else() handlers return an expected");
+        static_assert(std::is_same_v<typename is_expected_type<R>::value_type, T>, "or_else() cannot change the value type");
+        if (s) {
+            if constexpr (std::is_void_v<T>) {
+                return R();
+            } else {
+                return R(std::forward<S>(s).value());
+            }
+        }
+        return R(std::invoke(std::forward<F>(f), std::forward<S>(s).error()));
+    }
+
+    template <typename S, typename F>
+    static constexpr auto transform_error_impl(S&& s, F&& f) {
+        using G = std::remove_cvref_t<std::invoke_result_t<F, decltype(std::forward<S>(s).error())>>;
+        if (s) {
+            if constexpr (std::is_void_v<T>) {
+                return expected<T, G>();
+            } else {
+                return expected<T, G>(std::forward<S>(s).value());
+            }
+        }
+        return expected<T, G>(unexpected<G>(std::invoke(std::forward<F>(f), std::forward<S>(s).error())));
+    }
+};
+
+// An expected over such types is trivially copyable itself: it is copied as
+// plain bytes, passed and returned in registers when small enough, and usable
+// in constant expressions.
+template <typename... Ts>
+concept trivially_copyable = (std::is_trivially_copyable_v<Ts> && ...);
+
+} // namespace details
+
+template<typename T, typename E>
+class expected : public details::expected_operations<expected<T, E>, T, E> {
+public:
+    typedef expected<T, E> type;
+
+    constexpr explicit expected() : _value() {}
+    constexpr explicit expected(T const& v) : _value(v) {}
+    template<class TT = T> constexpr explicit expected(T&& v) noexcept : _value(std::forward<TT>(v)) {}
+
+    expected(expected const&) requires details::trivially_copyable<T, E> = default;
+    expected(expected&&) requires details::trivially_copyable<T, E> = default;
+    expected& operator= (expected const&) requires details::trivially_copyable<T, E> = default;
+    expected& operator= (expected&&) requires details::trivially_copyable<T, E> = default;
+    ~expected() requires details::trivially_copyable<T, E> = default;
+
+    constexpr expected(expected const& v) : ok(v.ok) {
+        construct_from(v);
     }
 
-    expected(unexpected<E>&& e) noexcept : ok(false) {
-        new(&_error) E(std::move(e.error));
+    constexpr expected(expected && v) noexcept(std::is_nothrow_move_constructible_v<T> && std::is_nothrow_move_constructible_v<E>)
+        : ok(v.ok) {
+        construct_from(std::move(v));
     }
 
-    operator bool() const { return ok; }
+    constexpr expected(unexpected<E> const& e) : ok(false), _error(e.error) {}
+    constexpr expected(unexpected<E>&& e) noexcept : ok(false), _error(std::move(e.error)) {}
 
-    T& operator*() & {
-        if constexpr (std::is_same<std::exception_ptr, E>::value) {
-            if (!ok) std::rethrow_exception(_error);
-        } else {
-            if (!ok) throw _error;
-        }
+    constexpr operator bool() const { return ok; }
+
+    constexpr T& operator*() & {
+        if (!ok) details::bad_expected_access(_error);
         return _value;
     }
 
-    T&& operator*() && {
-        if constexpr (std::is_same<std::exception_ptr, E>::value) {
-            if (!ok) std::rethrow_exception(_error);
-        } else {
-            if (!ok) throw _error;
-        }
-        return _value;
+    constexpr T&& operator*() && {
+        if (!ok) details::bad_expected_access(_error);
+        return std::move(_value);
     }
 
-    T const& operator*() const& {
-        if constexpr (std::is_same<std::exception_ptr, E>::value) {
-            if (!ok) std::rethrow_exception(_error);
-        } else {
-            if (!ok) throw _error;
-        }
+    constexpr T const& operator*() const& {
+        if (!ok) details::bad_expected_access(_error);
         return _value;
     }
 
-    E const& error() const& {
+    constexpr E const& error() const& {
         assert(!ok);
         return _error;
     }
 
-    E& error() & {
+    constexpr E& error() & {
         assert(!ok);
         return _error;
     }
 
-    E&& error() && {
+    constexpr E&& error() && {
         assert(!ok);
-        return _error;
+        return std::move(_error);
     }
 
-    T& value() & {
+    constexpr T& value() & {
         assert(ok);
         return _value;
     }
 
-    T const& value() const& {
+    constexpr T const& value() const& {
         assert(ok);
         return _value;
     }
 
-    T&& value() && {
+    constexpr T&& value() && {
         assert(ok);
-        return _value;
+        return std::move(_value);
     }
 
-    expected& operator= (expected const& o) noexcept {
-        destroy();
-
-        ok = o.ok;
-        if (ok) new(&_value) T(o._value);
-        else _error = new(&_error) E(o._error);
-
+    constexpr expected& operator= (expected const& o) {
+        if (this != &o) {
+            destroy();
+            ok = o.ok;
+            construct_from(o);
+        }
         return *this;
     }
 
-    expected& operator= (expected&& o) noexcept {
-        destroy();
-
-        ok = o.ok;
-        if (ok) new(&_value) T(std::move(o._value));
-        else new(&_error) E(std::move(o._error));
-
+    constexpr expected& operator= (expected&& o) noexcept {
+        if (this != &o) {
+            destroy();
+            ok = o.ok;
+            construct_from(std::move(o));
+        }
         return *this;
     }
 
-    expected& operator= (unexpected<E>&& e) {
+    constexpr expected& operator= (unexpected<E>&& e) {
         destroy();
         ok = false;
-        _error = std::move(e.error);
+        std::construct_at(&_error, std::move(e.error));
         return *this;
     }
 
-    expected& operator= (unexpected<E> const& e) {
+    constexpr expected& operator= (unexpected<E> const& e) {
         destroy();
         ok = false;
-        _error = e.error;
+        std::construct_at(&_error, e.error);
         return *this;
     }
 
-    ~expected() {
+    constexpr ~expected() {
         destroy();
     }
 
 private:
-    void destroy() {
-        if (ok) _value.~T();
-        else _error.~E();
+    template <typename Other>
+    constexpr void construct_from(Other&& o) {
+        if (ok) std::construct_at(&_value, std::forward<Other>(o)._value);
+        else std::construct_at(&_error, std::forward<Other>(o)._error);
+    }
 
-        new(&_error) E();
+    constexpr void destroy() {
+        if (ok) std::destroy_at(&_value);
+        else std::destroy_at(&_error);
     }
 
     bool ok = true;
@@ -161,94 +289,180 @@ private:
 // Not sure how standard implementation going to handle this
 // but in my understanding void is valid non-exception
 template<typename E>
-class expected<void, E> {
+class expected<void, E> : public details::expected_operations<expected<void, E>, void, E> {
 public:
     typedef expected<void, E> type;
 
-    explicit expected() noexcept {}
+    constexpr explicit expected() noexcept {}
 
-    expected(expected const& v) : ok(v.ok) {}
+    expected(expected const&) requires details::trivially_copyable<E> = default;
+    expected(expected&&) requires details::trivially_copyable<E> = default;
+    expected& operator= (expected const&) requires details::trivially_copyable<E> = default;
+    expected& operator= (expected&&) requires details::trivially_copyable<E> = default;
+    ~expected() requires details::trivially_copyable<E> = default;
 
-    expected(expected && v) : ok(v.ok) {
-        if (!ok) new(&_error) E(std::move(v.error()));
+    constexpr expected(expected const& v) : ok(v.ok) {
+        if (!ok) std::construct_at(&_error, v._error);
     }
 
-    expected(unexpected<E> const& e) : ok(false) {
-        new(&_error) E(e.error);
+    constexpr expected(expected && v) noexcept(std::is_nothrow_move_constructible_v<E>) : ok(v.ok) {
+        if (!ok) std::construct_at(&_error, std::move(v._error));
     }
 
-    expected(unexpected<E>&& e) noexcept : ok(false) {
-        new(&_error) E(std::forward<E>(e.error));
-    }
+    constexpr expected(unexpected<E> const& e) : ok(false), _error(e.error) {}
+    constexpr expected(unexpected<E>&& e) noexcept : ok(false), _error(std::move(e.error)) {}
 
-    operator bool() const { return ok; }
+    constexpr operator bool() const { return ok; }
 
-    void operator*() const& {
-        if constexpr (std::is_same<std::exception_ptr, E>::value) {
-            if (!ok) std::rethrow_exception(_error);
-        } else {
-            if (!ok) throw _error;
-        }
+    constexpr void operator*() const& {
+        if (!ok) details::bad_expected_access(_error);
     }
 
-    E const& error() const& {
+    constexpr E const& error() const& {
         assert(!ok);
         return _error;
     }
 
-    E& error() & {
+    constexpr E& error() & {
         assert(!ok);
         return _error;
     }
 
-    E&& error() && {
+    constexpr E&& error() && {
         assert(!ok);
-        return _error;
+        return std::move(_error);
     }
 
-    expected& operator= (expected const& o) noexcept {
-        destroy();
-
-        ok = o.ok;
-        if (!ok) new(&_error) E(o._error);
-
+    constexpr expected& operator= (expected const& o) {
+        if (this != &o) {
+            destroy();
+            ok = o.ok;
+            if (!ok) std::construct_at(&_error, o._error);
+        }
         return *this;
     }
 
-    expected& operator= (expected&& o) noexcept {
-        destroy();
-
-        ok = o.ok;
-        if (!ok) new(&_error) E(std::move(o._error));
-
+    constexpr expected& operator= (expected&& o) noexcept {
+        if (this != &o) {
+            destroy();
+            ok = o.ok;
+            if (!ok) std::construct_at(&_error, std::move(o._error));
+        }
         return *this;
     }
 
-    expected& operator= (unexpected<E>&& e) {
+    constexpr expected& operator= (unexpected<E>&& e) {
         destroy();
         ok = false;
-        _error = std::move(e.error);
+        std::construct_at(&_error, std::move(e.error));
         return *this;
     }
 
-    expected& operator= (unexpected<E> const& e) {
+    constexpr expected& operator= (unexpected<E> const& e) {
         destroy();
         ok = false;
-        _error = e.error;
+        std::construct_at(&_error, e.error);
         return *this;
     }
 
-    ~expected() {
+    constexpr ~expected() {
         destroy();
     }
 
 private:
-    void destroy() {
-        if (!ok) _error.~E();
+    constexpr void destroy() {
+        if (!ok) std::destroy_at(&_error);
     }
 
     bool ok = true;
     union { E _error; };
 };
 
+// Compact layout for a T opted in with spare bits (see niche.hpp): an error is
+// kept in T's own storage, tagged with the bit no value of T has set, so the
+// whole expected is the size of T. It has the members of the generic layout;
+// telling a value from an error reads that bit from T's representation, which
+// constant evaluation cannot do.
+template<typename T, typename E>
+    requires details::niche_carries<T, E>
+class expected<T, E> : public details::expected_operations<expected<T, E>, T, E> {
+public:
+    typedef expected<T, E> type;
+
+    constexpr explicit expected() : _value() {}
+    constexpr explicit expected(T const& v) : _value(v) {
+        assert(!niche<T>::is_none(_value));
+    }
+    template<class TT = T> constexpr explicit expected(T&& v) noexcept : _value(std::forward<TT>(v)) {
+        assert(!niche<T>::is_none(_value));
+    }
+
+    constexpr expected(unexpected<E> const& e) : _error{1, e.error} {}
+    constexpr expected(unexpected<E>&& e) noexcept : _error{1, std::move(e.error)} {}
+
+    constexpr operator bool() const { return has_value(); }
+
+    constexpr T& operator*() & {
+        if (!has_value()) details::bad_expected_access(_error.error);
+        return _value;
+    }
+
+    constexpr T&& operator*() && {
+        if (!has_value()) details::bad_expected_access(_error.error);
+        return std::move(_value);
+    }
+
+    constexpr T const& operator*() const& {
+        if (!has_value()) details::bad_expected_access(_error.error);
+        return _value;
+    }
+
+    constexpr E const& error() const& {
+        assert(!has_value());
+        return _error.error;
+    }
+
+    constexpr E& error() & {
+        assert(!has_value());
+        return _error.error;
+    }
+
+    constexpr E&& error() && {
+        assert(!has_value());
+        return std::move(_error.error);
+    }
+
+    constexpr T& value() & {
+        assert(has_value());
+        return _value;
+    }
+
+    constexpr T const& value() const& {
+        assert(has_value());
+        return _value;
+    }
+
+    constexpr T&& value() && {
+        assert(has_value());
+        return std::move(_value);
+    }
+
+    constexpr expected& operator= (unexpected<E>&& e) {
+        std::construct_at(&_error, details::tagged_error<E>{1, std::move(e.error)});
+        return *this;
+    }
+
+    constexpr expected& operator= (unexpected<E> const& e) {
+        std::construct_at(&_error, details::tagged_error<E>{1, e.error});
+        return *this;
+    }
+
+private:
+    constexpr bool has_value() const noexcept {
+        return !(*reinterpret_cast<unsigned char const*>(std::addressof(_value)) & 1);
+    }
+
+    union { T _value; details::tagged_error<E> _error; };
+};
+
 }
@@ -0,0 +1,193 @@
+#pragma once
+
+#include "expected.hpp"
+
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace hntr::platform {
+
+// Columnar container of N results: the values and the errors are kept in two
+// separate contiguous arrays, and which of the two a slot holds in a bitmap.
+// Unlike a vector of expected there is no flag, padding or union per element,
+// and bulk operations run over plain arrays and bitmap words, which compilers
+// vectorise.
+//
+// Every slot has room for both a value and an error, so T and E must be
+// default constructible; a slot starts out holding a value-initialised error.
+// Different slots may be set from different threads at the same time.
+template <typename T, typename E>
+class expected_array {
+    static_assert(!std::is_same_v<T, bool> && !std::is_same_v<E, bool>, "columns of bool are bit-packed; use a byte-sized type");
+
+public:
+    using value_type = T;
+    using error_type = E;
+
+    expected_array() = default;
+
+    explicit expected_array(std::size_t size)
+        : _values(size)
+        , _errors(size)
+        , _bits((size + 63) / 64)
+    {}
+
+    std::size_t size() const noexcept {
+        return _values.size();
+    }
+
+    bool has_value(std::size_t i) const noexcept {
+        return (_bits[i / 64] >> (i % 64)) & 1;
+    }
+
+    T& value(std::size_t i) {
+        assert(has_value(i));
+        return _values[i];
+    }
+
+    T const& value(std::size_t i) const {
+        assert(has_value(i));
+        return _values[i];
+    }
+
+    E& error(std::size_t i) {
+        assert(!has_value(i));
+        return _errors[i];
+    }
+
+    E const& error(std::size_t i) const {
+        assert(!has_value(i));
+        return _errors[i];
+    }
+
+    // The slot as an expected; this copies it out.
+    expected<T, E> operator[] (std::size_t i) const {
+        if (has_value(i)) {
+            return expected<T, E>(_values[i]);
+        }
+        return expected<T, E>(unexpected<E>(_errors[i]));
+    }
+
+    template <typename TT = T>
+    void set_value(std::size_t i, TT&& v) {
+        _values[i] = std::forward<TT>(v);
+        word(i).fetch_or(bit(i), std::memory_order_relaxed);
+    }
+
+    template <typename EE = E>
+    void set_error(std::size_t i, EE&& e) {
+        _errors[i] = std::forward<EE>(e);
+        word(i).fetch_and(~bit(i), std::memory_order_relaxed);
+    }
+
+    void set(std::size_t i, expected<T, E> const& r) {
+        if (r) set_value(i, *r);
+        else set_error(i, r.error());
+    }
+
+    void set(std::size_t i, expected<T, E>&& r) {
+        if (r) set_value(i, *std::move(r));
+        else set_error(i, std::move(r).error());
+    }
+
+    std::size_t count_values() const noexcept {
+        std::size_t n = 0;
+        for (auto w : _bits) {
+            n += std::popcount(w);
+        }
+        return n;
+    }
+
+    std::size_t count_errors() const noexcept {
+        return size() - count_values();
+    }
+
+    // The values of the successful slots, in slot order.
+    std::vector<T> successes() const& {
+        std::vector<T> out;
+        out.reserve(count_values());
+        for_each_set_bit([&](std::size_t i) { out.push_back(_values[i]); });
+        return out;
+    }
+
+    std::vector<T> successes() && {
+        std::vector<T> out;
+        out.reserve(count_values());
+        for_each_set_bit([&](std::size_t i) { out.push_back(std::move(_values[i])); });
+        return out;
+    }
+
+    // Applies `f` to the value of every successful slot and keeps the errors
+    // and the bitmap as they are. `f` is never called for a slot holding an
+    // error; the value column of the result has a value-initialised U there.
+    template <typename F, typename U = std::remove_cvref_t<std::invoke_result_t<F&, T const&>>>
+    expected_array<U, E> transform_values(F&& f) const& {
+        expected_array<U, E> out(size(), _errors, _bits);
+        for_each_set_bit([&](std::size_t i) { out._values[i] = f(_values[i]); });
+        return out;
+    }
+
+    template <typename F, typename U = std::remove_cvref_t<std::invoke_result_t<F&, T&&>>>
+    expected_array<U, E> transform_values(F&& f) && {
+        expected_array<U, E> out(size(), std::move(_errors), std::move(_bits));
+        // The bitmap has moved to `out`.
+        out.for_each_set_bit([&](std::size_t i) { out._values[i] = f(std::move(_values[i])); });
+        return out;
+    }
+
+    // Raw columns for bulk work of one's own. Slot i holds a value exactly if
+    // bit i % 64 of bitmap()[i / 64] is set.
+    std::span<T> value_column() noexcept { return _values; }
+    std::span<T const> value_column() const noexcept { return _values; }
+    std::span<E> error_column() noexcept { return _errors; }
+    std::span<E const> error_column() const noexcept { return _errors; }
+    std::span<std::uint64_t const> bitmap() const noexcept { return _bits; }
+
+private:
+    template <typename, typename> friend class expected_array;
+
+    template <typename Errors, typename Bits>
+    expected_array(std::size_t size, Errors&& errors, Bits&& bits)
+        : _values(size)
+        , _errors(std::forward<Errors>(errors))
+        , _bits(std::forward<Bits>(bits))
+    {}
+
+    static std::uint64_t bit(std::size_t i) noexcept {
+        return std::uint64_t(1) << (i % 64);
+    }
+
+    // Neighbouring slots share a word, so writers update it atomically.
+    std::atomic_ref<std::uint64_t> word(std::size_t i) noexcept {
+        return std::atomic_ref<std::uint64_t>(_bits[i / 64]);
+    }
+
+    // A word of successes only runs as a plain loop, which compilers vectorise.
+    template <typename F>
+    void for_each_set_bit(F&& f) const {
+        for (std::size_t w = 0; w < _bits.size(); ++w) {
+            if (_bits[w] == ~std::uint64_t(0)) {
+                for (std::size_t i = w * 64; i < w * 64 + 64; ++i) {
+                    f(i);
+                }
+                continue;
+            }
+            for (auto bits = _bits[w]; bits; bits &= bits - 1) {
+                f(w * 64 + std::countr_zero(bits));
+            }
+        }
+    }
+
+    std::vector<T> _values;
+    std::vector<E> _errors;
+    std::vector<std::uint64_t> _bits;
+};
+
+}
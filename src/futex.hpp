@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace hntr::platform::details {
+
+// Blocking on a 32-bit atomic word. Waits may return spuriously, so callers
+// re-check the word in a loop. Waking only needs the address of the word: it is
+// fine to wake after the waiter has returned and released the memory, which is
+// what lets a producer publish and then wake without holding a reference.
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+#if defined(__linux__)
+
+static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t));
+
+inline long futex(std::atomic<std::uint32_t> const& word, int op, std::uint32_t value, timespec const* timeout) {
+    return syscall(SYS_futex, reinterpret_cast<std::uint32_t const*>(&word), op | FUTEX_PRIVATE_FLAG, value, timeout, nullptr, 0);
+}
+
+inline void futex_wait(std::atomic<std::uint32_t> const& word, std::uint32_t expected) {
+    futex(word, FUTEX_WAIT, expected, nullptr);
+}
+
+// Returns false if the timeout elapsed.
+inline bool futex_wait_for(std::atomic<std::uint32_t> const& word, std::uint32_t expected, std::chrono::nanoseconds timeout) {
+    timespec ts;
+    ts.tv_sec = static_cast<time_t>(timeout.count() / 1000000000);
+    ts.tv_nsec = static_cast<long>(timeout.count() % 1000000000);
+    return futex(word, FUTEX_WAIT, expected, &ts) == 0 || errno != ETIMEDOUT;
+}
+
+inline void futex_wake_all(std::atomic<std::uint32_t> const& word) {
+    futex(word, FUTEX_WAKE, INT_MAX, nullptr);
+}
+
+#else
+
+// Portable fallback: a fixed table of buckets hashed by address. The buckets
+// are never destroyed, so waking a word that is already gone stays harmless.
+struct parking_bucket {
+    std::mutex mutex;
+    std::condition_variable cond;
+};
+
+inline parking_bucket& parking_bucket_for(void const* address) {
+    static parking_bucket buckets[64];
+    return buckets[(reinterpret_cast<std::uintptr_t>(address) >> 4) % 64];
+}
+
+inline void futex_wait(std::atomic<std::uint32_t> const& word, std::uint32_t expected) {
+    auto& bucket = parking_bucket_for(&word);
+    std::unique_lock lock(bucket.mutex);
+    if (word.load(std::memory_order_acquire) == expected) {
+        bucket.cond.wait(lock);
+    }
+}
+
+inline bool futex_wait_for(std::atomic<std::uint32_t> const& word, std::uint32_t expected, std::chrono::nanoseconds timeout) {
+    auto& bucket = parking_bucket_for(&word);
+    std::unique_lock lock(bucket.mutex);
+    if (word.load(std::memory_order_acquire) == expected) {
+        return bucket.cond.wait_for(lock, timeout) == std::cv_status::no_timeout;
+    }
+    return true;
+}
+
+inline void futex_wake_all(std::atomic<std::uint32_t> const& word) {
+    auto& bucket = parking_bucket_for(&word);
+    std::lock_guard lock(bucket.mutex);
+    bucket.cond.notify_all();
+}
+
+#endif
+
+// Spins for a bounded, self-tuning number of iterations waiting for `ready()`.
+// The budget grows when spinning pays off and shrinks when the caller ends up
+// parking anyway, so short handoffs avoid the syscall and long waits stop
+// burning cycles.
+template <typename Predicate>
+bool spin_until(Predicate&& ready) {
+    constexpr std::uint32_t min_spins = 16;
+    constexpr std::uint32_t max_spins = 4096;
+    static thread_local std::uint32_t budget = 256;
+
+    for (std::uint32_t i = 0; i < budget; ++i) {
+        if (ready()) {
+            budget = budget < max_spins ? budget * 2 : max_spins;
+            return true;
+        }
+        cpu_relax();
+    }
+    budget = budget > min_spins ? budget / 2 : min_spins;
+    return ready();
+}
+
+} // namespace hntr::platform::details
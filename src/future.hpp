@@ -1,15 +1,24 @@
 #pragma once
 
+#include "executor.hpp"
 #include "expected.hpp"
+#include "futex.hpp"
+#include "node_pool.hpp"
 
 #include "optional.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
 #include <exception>
-#include <condition_variable>
 #include <type_traits>
 #include <functional>
 #include <memory>
+#include <memory_resource>
+#include <span>
 #include <utility>
+#include <vector>
 
 namespace hntr::platform {
 
@@ -18,202 +27,857 @@ template<typename T> void ptype(T&& parameter);
 template <typename T, typename E> class promise;
 template <typename T, typename E> class future;
 template <typename T, typename E> class cancellable_future;
+template <typename Source, typename F> class pipeline;
 
 namespace details {
 
+struct future_access;
+
+// Owning pointer for objects that carry their own reference count and expose
+// add_ref()/release(). Shared states are allocated once and counted in place,
+// so there is no separate control block and no weak count.
+template <typename T>
+class intrusive_ptr {
+public:
+    intrusive_ptr() noexcept = default;
+    explicit intrusive_ptr(T* p) noexcept : _p(p) {}
+    intrusive_ptr(intrusive_ptr const& o) noexcept : _p(o._p) { if (_p) _p->add_ref(); }
+    intrusive_ptr(intrusive_ptr&& o) noexcept : _p(std::exchange(o._p, nullptr)) {}
+
+    template <typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+    intrusive_ptr(intrusive_ptr<U>&& o) noexcept : _p(o.detach()) {}
+
+    template <typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+    intrusive_ptr(intrusive_ptr<U> const& o) noexcept : _p(o.get()) { if (_p) _p->add_ref(); }
+
+    intrusive_ptr& operator= (intrusive_ptr o) noexcept {
+        std::swap(_p, o._p);
+        return *this;
+    }
+
+    ~intrusive_ptr() {
+        if (_p) _p->release();
+    }
+
+    // Takes an additional reference on an object already owned elsewhere.
+    static intrusive_ptr share(T* p) noexcept {
+        p->add_ref();
+        return intrusive_ptr(p);
+    }
+
+    T* detach() noexcept { return std::exchange(_p, nullptr); }
+
+    T* get() const noexcept { return _p; }
+    T* operator-> () const noexcept { return _p; }
+    T& operator* () const noexcept { return *_p; }
+    explicit operator bool() const noexcept { return _p != nullptr; }
+
+private:
+    T* _p = nullptr;
+};
+
+template <typename T, typename... Args>
+intrusive_ptr<T> make_intrusive(Args&&... args) {
+    return intrusive_ptr<T>(new T(std::forward<Args>(args)...));
+}
+
+// Consumer slot of a precursor.
+//
+// A consumer is either an object whose concrete type is known when it is
+// attached - a link, an awaiter, a join element - or a small callable stored
+// in place. Objects provide handle(value const&), handle(value&&) and
+// discard(), and may expose a suspended coroutine through coroutine(). Both
+// kinds are reached through a static table of plain function pointers built
+// for the exact type, so handing a value over is one indirect call with no
+// virtual dispatch. Callables larger than the buffer are moved to the heap.
+//
+// The slot owns its consumer until it hands the value over: handle()
+// transfers ownership to the callee, and discard() is called instead if the
+// state dies without a value.
 template <typename T, typename E>
-class continuation {
+class continuation_slot {
 public:
     using value_type = expected<T, E>;
-    virtual ~continuation() = default;
 
-    virtual void handle(expected<T, E> const& value) = 0;
-    virtual void handle(expected<T, E> && value) = 0;
+    // Room for a lambda capturing three pointers.
+    static constexpr std::size_t capacity = 3 * sizeof(void*);
+
+    continuation_slot() = default;
+    continuation_slot(continuation_slot const&) = delete;
+    continuation_slot& operator= (continuation_slot const&) = delete;
+
+    ~continuation_slot() {
+        discard();
+    }
+
+    explicit operator bool() const noexcept {
+        return _ops != nullptr;
+    }
+
+    template <typename C>
+    void attach(C* cont) noexcept {
+        assert(!_ops);
+        ::new (static_cast<void*>(_storage)) C*(cont);
+        _ops = &object_ops<C>;
+    }
+
+    template <typename F>
+    void emplace(F&& f) {
+        using callable = std::decay_t<F>;
+        assert(!_ops);
+        if constexpr (stored_in_place<callable>) {
+            ::new (static_cast<void*>(_storage)) callable(std::forward<F>(f));
+            _ops = &in_place_ops<callable>;
+        } else {
+            ::new (static_cast<void*>(_storage)) callable*(new callable(std::forward<F>(f)));
+            _ops = &on_heap_ops<callable>;
+        }
+    }
+
+    void handle(value_type const& value) {
+        std::exchange(_ops, nullptr)->handle_copy(_storage, value);
+    }
+
+    void handle(value_type&& value) {
+        std::exchange(_ops, nullptr)->handle_move(_storage, std::move(value));
+    }
+
+    void discard() noexcept {
+        if (auto* ops = std::exchange(_ops, nullptr)) {
+            ops->discard(_storage);
+        }
+    }
+
+    // A consumer that does nothing but resume a suspended coroutine exposes
+    // it, so a producer that is itself a coroutine can transfer to it instead
+    // of resuming it on its own stack.
+    std::coroutine_handle<> coroutine() const noexcept {
+        return _ops ? _ops->coroutine(_storage) : nullptr;
+    }
+
+    // Empties the slot without notifying an attached object, which is then
+    // the caller's again.
+    void forget() noexcept {
+        assert(!_ops || _ops->is_object);
+        _ops = nullptr;
+    }
+
+private:
+    struct ops {
+        void (*handle_copy)(void* storage, value_type const& value);
+        void (*handle_move)(void* storage, value_type&& value);
+        void (*discard)(void* storage) noexcept;
+        std::coroutine_handle<> (*coroutine)(void const* storage) noexcept;
+        bool is_object;
+    };
+
+    template <typename F>
+    static constexpr bool stored_in_place = sizeof(F) <= capacity && alignof(F) <= alignof(void*);
+
+    template <typename C>
+    static C* object(void const* storage) noexcept {
+        return *static_cast<C* const*>(storage);
+    }
+
+    template <typename C>
+    static std::coroutine_handle<> object_coroutine(void const* storage) noexcept {
+        if constexpr (requires (C const& c) { c.coroutine(); }) {
+            return object<C>(storage)->coroutine();
+        } else {
+            return nullptr;
+        }
+    }
+
+    static std::coroutine_handle<> no_coroutine(void const*) noexcept {
+        return nullptr;
+    }
+
+    // The callable is destroyed after the call, even if it throws.
+    template <typename F, typename V>
+    static void invoke_and_destroy(F& f, V&& value) {
+        struct destroy_after {
+            F& f;
+            ~destroy_after() { f.~F(); }
+        } guard{f};
+        f(std::forward<V>(value));
+    }
+
+    template <typename C>
+    static constexpr ops object_ops = {
+        [](void* storage, value_type const& value) { object<C>(storage)->handle(value); },
+        [](void* storage, value_type&& value) { object<C>(storage)->handle(std::move(value)); },
+        [](void* storage) noexcept { object<C>(storage)->discard(); },
+        &object_coroutine<C>,
+        true,
+    };
+
+    template <typename F>
+    static constexpr ops in_place_ops = {
+        [](void* storage, value_type const& value) { invoke_and_destroy(*static_cast<F*>(storage), value); },
+        [](void* storage, value_type&& value) { invoke_and_destroy(*static_cast<F*>(storage), std::move(value)); },
+        [](void* storage) noexcept { static_cast<F*>(storage)->~F(); },
+        &no_coroutine,
+        false,
+    };
+
+    template <typename F>
+    static constexpr ops on_heap_ops = {
+        [](void* storage, value_type const& value) { std::unique_ptr<F> f(object<F>(storage)); (*f)(value); },
+        [](void* storage, value_type&& value) { std::unique_ptr<F> f(object<F>(storage)); (*f)(std::move(value)); },
+        [](void* storage) noexcept { delete object<F>(storage); },
+        &no_coroutine,
+        false,
+    };
+
+    ops const* _ops = nullptr;
+    alignas(void*) unsigned char _storage[capacity];
 };
 
+// Per-thread trampoline for continuations that run inline.
+//
+// Fulfilling a state runs its continuation on the fulfilling thread, which
+// may fulfil the next state and so on: a long chain, or a loop of handlers
+// returning futures, would nest one frame per hop. Each dispatch therefore
+// enters a frame; up to `inline_depth` frames run nested as before, and a
+// dispatch beyond that is deferred to the executor running the thread (see
+// current_executor()). A thread running no executor's work queues it instead
+// and bounces it from the outermost frame once what it is running returns.
+// Either way stack use stays bounded whatever the length of the chain.
+//
+// A deferred continuation has not run yet when the handler fulfilling its
+// state goes on. A reader about to block in get() therefore first runs what
+// this thread has queued, so waiting on a future chained from one it has just
+// fulfilled completes as it did inline. Work deferred to an executor is only
+// run by that executor: a handler blocking on it needs another thread of the
+// executor to be free.
+class trampoline {
+public:
+    // Deferred dispatch. The state being dispatched is its own queue entry.
+    class hop {
+    public:
+        virtual void bounce() = 0;
+
+    protected:
+        hop() noexcept : _entry(*this) {}
+        ~hop() = default;
+
+    private:
+        friend class trampoline;
+
+        // The task an executor, or this thread's queue, holds for the hop.
+        class entry final : public task {
+        public:
+            explicit entry(hop& owner) noexcept : _owner(owner) {}
+
+            void run() override {
+                _owner.bounce();
+            }
+
+        private:
+            hop& _owner;
+        };
+
+        entry _entry;
+    };
+
+    class frame {
+    public:
+        frame() noexcept : _entered(_depth == 0 || _depth < _inline_depth.load(std::memory_order_relaxed)) {
+            _depth += _entered;
+        }
+
+        frame(frame const&) = delete;
+        frame& operator= (frame const&) = delete;
+
+        // An exception out of the dispatch skips drain(): what it queued is
+        // left to the next outermost frame, or reader, on this thread.
+        ~frame() {
+            _depth -= _entered;
+        }
+
+        // False when the dispatch must be deferred.
+        explicit operator bool() const noexcept {
+            return _entered;
+        }
+
+        // Runs what nested frames queued; only the outermost frame does.
+        void drain() {
+            if (_depth == 1) {
+                run_pending();
+            }
+        }
+
+    private:
+        bool _entered;
+    };
+
+    static void defer(hop& h) {
+        task& t = h._entry;
+        if (auto* executor = current_executor()) {
+            executor->defer(t);
+            return;
+        }
+        t.next = nullptr;
+        if (_tail) {
+            _tail->next = &t;
+        } else {
+            _head = &t;
+        }
+        _tail = &t;
+    }
+
+    // Runs everything this thread has queued, including what the queued work
+    // queues in turn.
+    static void run_pending() {
+        while (auto* t = _head) {
+            _head = std::exchange(t->next, nullptr);
+            if (!_head) {
+                _tail = nullptr;
+            }
+            t->run();
+        }
+    }
 
+    static std::size_t inline_depth() noexcept {
+        return _inline_depth.load(std::memory_order_relaxed);
+    }
+
+    static void set_inline_depth(std::size_t depth) noexcept {
+        _inline_depth.store(depth, std::memory_order_relaxed);
+    }
+
+private:
+    static inline std::atomic<std::size_t> _inline_depth{64};
+    static inline thread_local std::size_t _depth = 0;
+    static inline thread_local task* _head = nullptr;
+    static inline thread_local task* _tail = nullptr;
+};
+
+
+// Shared state between a producer and its single consumer.
+//
+// All transitions go through one atomic state word: the producer publishes the
+// value and sets `value_ready`, the consumer installs its continuation and sets
+// `continuation_attached`. Whichever side completes the pair (`done`) runs the
+// continuation, so neither side ever takes a lock. Readers that find no value
+// in get() spin for a short while and then park on the state word; a producer
+// only issues a wake-up when it observes the `waiting` bit.
+//
+// The state is reference counted in place: promise, future and the upstream
+// continuation slot each hold one reference.
 template <typename T, typename E>
-class precursor {
+class precursor : private trampoline::hop {
 public:
     using value_type = expected<T, E>;
 
+    precursor() = default;
+    precursor(precursor const&) = delete;
+    precursor& operator= (precursor const&) = delete;
+    virtual ~precursor() = default;
+
+#if defined(HNTR_PLATFORM_NODE_POOL)
+    // Links and joins derive from the precursor and are destroyed through its
+    // virtual destructor, so these see the size of the most derived node.
+    static void* operator new(std::size_t size) {
+        return node_pool::allocate(size);
+    }
+
+    static void operator delete(void* p, std::size_t size) noexcept {
+        node_pool::deallocate(p, size);
+    }
+#endif
+
+    void add_ref() noexcept {
+        _refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release() noexcept {
+        if (_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            destroy();
+        }
+    }
+
+    // Nodes allocated from a memory resource return their memory there; then()
+    // allocates the next link from the resource of the state it attaches to.
+    virtual std::pmr::memory_resource* resource() const noexcept {
+        return nullptr;
+    }
+
+    enum state : std::uint32_t {
+        empty = 0,
+        value_ready = 1 << 0,
+        continuation_attached = 1 << 1,
+        done = value_ready | continuation_attached,
+        waiting = 1 << 2,
+    };
+
     operator bool() const {
-        std::lock_guard lock(_mutex);
-        return !!_value;
+        return _state.load(std::memory_order_acquire) & value_ready;
+    }
+
+    // The stored result if it has been published, without waiting.
+    value_type const* try_get() const noexcept {
+        return *this ? &*_value : nullptr;
     }
 
     value_type const& get() const& {
-        std::unique_lock lock(_mutex);
-        _cond.wait(lock, [this]() { return !!_value; });
+        wait();
         return *_value;
     }
 
     value_type& get()& {
-        std::unique_lock lock(_mutex);
-        _cond.wait(lock, [this]() { return !!_value; });
+        wait();
         return *_value;
     }
 
     value_type&& get()&& {
-        std::unique_lock lock(_mutex);
-        _cond.wait(lock, [this]() { return !!_value; });
-        return *_value;
+        wait();
+        return std::move(*_value);
     }
 
     template <class _Rep, class _Period>
     optional<T> get(std::chrono::duration<_Rep, _Period> const& duration) {
-        std::unique_lock lock(_mutex);
-        auto result = _cond.wait_for(lock, duration, [this]() { return !!_value; });
-        if (!result) {
+        if (!wait_for(duration)) {
             return {};
         }
-        return *_value;
+        return optional<T>(**_value);
     }
 
+    // The producer calling these holds a reference of its own; if it is the
+    // only one left, no future can read the value any more and it is moved
+    // into the continuation instead of being copied.
     void set_value(value_type const& v) {
-        std::lock_guard lock(_mutex);
-        assert(!_value);
+        assert(!*this);
         _value = v;
-        if (_cont) {
-            _cont->handle(*_value);
-        }
-        _cond.notify_all();
+        publish([this](bool attached) {
+            if (attached) dispatch(unshared());
+        });
     }
 
     void set_value(value_type&& v) {
-        std::lock_guard lock(_mutex);
+        assert(!*this);
         _value = std::move(v);
-        if (_cont) {
-            _cont->handle(*_value);
+        publish([this](bool attached) {
+            if (attached) dispatch(unshared());
+        });
+    }
+
+    // For a producer that holds no reference, such as a stop callback: the
+    // references left may all belong to readers, so the value is copied.
+    void set_value_unowned(value_type&& v) {
+        assert(!*this);
+        _value = std::move(v);
+        publish([this](bool attached) {
+            if (attached) dispatch(false);
+        });
+    }
+
+    // Publishes the value on behalf of a producer that is a coroutine at its
+    // final suspend point: a consumer that is a suspended coroutine is
+    // returned for symmetric transfer rather than resumed on this stack.
+    std::coroutine_handle<> set_value_and_transfer(value_type&& v) {
+        assert(!*this);
+        _value = std::move(v);
+        return publish([this](bool attached) -> std::coroutine_handle<> {
+            if (!attached) {
+                return std::noop_coroutine();
+            }
+            if (auto coroutine = _cont.coroutine()) {
+                _cont.forget();
+                return coroutine;
+            }
+            dispatch(unshared());
+            return std::noop_coroutine();
+        });
+    }
+
+    // Takes ownership of `cont` and runs it as soon as the value is there,
+    // immediately if it already is. A caller that `consumes` its own reference
+    // lets a value that is already there be moved into `cont` when nobody else
+    // refers to the state.
+    template <typename C>
+    void set_continuation(C* cont, bool consume = false) {
+        _cont.attach(cont);
+        if (mark_attached() & value_ready) {
+            dispatch(consume && unshared());
         }
-        _cond.notify_all();
     }
 
-    void set_continuation(std::shared_ptr<continuation<T, E>> cont) {
-        std::lock_guard lock(_mutex);
-        assert(!_cont);
-        _cont = cont;
-        if (_value) {
-            _cont->handle(std::move(*_value));
+    // Installs `cont` unless the value has already been published. Returns
+    // false in that case, leaving `cont` with the caller.
+    template <typename C>
+    bool attach(C* cont) {
+        _cont.attach(cont);
+        if (mark_attached() & value_ready) {
+            _cont.forget();
+            return false;
         }
+        return true;
+    }
+
+    // Stores `callback` in the state and calls it with the value as soon as
+    // the value is there, immediately if it already is.
+    template <typename F>
+    void set_callback(F&& callback, bool consume = false) {
+        _cont.emplace(std::forward<F>(callback));
+        if (mark_attached() & value_ready) {
+            dispatch(consume && unshared());
+        }
+    }
+
+    // True when the caller holds the only reference to the state.
+    bool unshared() const noexcept {
+        return _refs.load(std::memory_order_acquire) == 1;
+    }
+
+protected:
+    virtual void destroy() noexcept {
+        delete this;
     }
 
 private:
-    std::condition_variable _cond;
-    mutable std::mutex _mutex;
+    // Publish, then dispatch: readers blocked in get() are released before the
+    // continuation runs, and the continuation itself runs with no lock held, so
+    // handler cost never lands on other threads and handlers may freely re-enter
+    // this state or resolve nested futures.
+    template <typename Complete>
+    auto publish(Complete&& complete) {
+        auto prev = _state.fetch_or(value_ready, std::memory_order_acq_rel);
+        wake(prev);
+        return complete(!!(prev & continuation_attached));
+    }
+
+    // Runs the continuation through the trampoline. A deferred one keeps the
+    // state alive until it is bounced, here or by an executor; whether it may
+    // take the value was decided now, while the references were the caller's.
+    void dispatch(bool move) {
+        trampoline::frame frame;
+        if (!frame) {
+            _bounce_move = move;
+            add_ref();
+            trampoline::defer(*this);
+            return;
+        }
+        hand_over(move);
+        frame.drain();
+    }
+
+    void bounce() override {
+        intrusive_ptr<precursor> self(this);
+        hand_over(_bounce_move);
+    }
+
+    void hand_over(bool move) {
+        if (move) {
+            _cont.handle(std::move(*_value));
+        } else {
+            _cont.handle(std::as_const(*_value));
+        }
+    }
+
+    std::uint32_t mark_attached() {
+        assert(!(_state.load(std::memory_order_relaxed) & continuation_attached));
+        return _state.fetch_or(continuation_attached, std::memory_order_acq_rel);
+    }
+
+    // Spins briefly, then parks on the state word itself. Only a reader that
+    // is about to park sets `waiting`, so fulfilment makes no syscall unless
+    // somebody is actually blocked. The value may be waiting on continuations
+    // this thread has deferred, which run first.
+    void wait() const {
+        if (*this) {
+            return;
+        }
+        trampoline::run_pending();
+        if (*this || spin_until([this]() { return !!*this; })) {
+            return;
+        }
+        auto state = _state.fetch_or(waiting, std::memory_order_acq_rel) | waiting;
+        while (!(state & value_ready)) {
+            futex_wait(_state, state);
+            state = _state.load(std::memory_order_acquire);
+        }
+    }
+
+    template <class _Rep, class _Period>
+    bool wait_for(std::chrono::duration<_Rep, _Period> const& duration) const {
+        if (*this) {
+            return true;
+        }
+        trampoline::run_pending();
+        if (*this || spin_until([this]() { return !!*this; })) {
+            return true;
+        }
+        const auto deadline = std::chrono::steady_clock::now() + duration;
+        auto state = _state.fetch_or(waiting, std::memory_order_acq_rel) | waiting;
+        while (!(state & value_ready)) {
+            const auto left = deadline - std::chrono::steady_clock::now();
+            if (left <= left.zero()) {
+                return false;
+            }
+            futex_wait_for(_state, state, std::chrono::duration_cast<std::chrono::nanoseconds>(left));
+            state = _state.load(std::memory_order_acquire);
+        }
+        return true;
+    }
+
+    // Only the address of the word is used, so a reader that has already
+    // returned and dropped the state does not make this unsafe.
+    void wake(std::uint32_t prev) {
+        if (prev & waiting) {
+            futex_wake_all(_state);
+        }
+    }
+
+    mutable std::atomic<std::uint32_t> _state{empty};
+    std::atomic<std::uint32_t> _refs{1};
+    bool _bounce_move = false;
     optional<value_type> _value;
-    std::shared_ptr<continuation<T, E>> _cont;
+    continuation_slot<T, E> _cont;
 };
 
-template <typename T, typename E> using precursor_ptr = std::shared_ptr<precursor<T,E>>;
+template <typename T, typename E> using precursor_ptr = intrusive_ptr<precursor<T,E>>;
+
+// Node living in a caller-supplied memory resource; it remembers the resource
+// and gives its memory back there when the last reference goes.
+template <typename Node>
+class resource_node final : public Node {
+public:
+    template <typename... Args>
+    explicit resource_node(std::pmr::memory_resource* resource, Args&&... args)
+        : Node(std::forward<Args>(args)...)
+        , _resource(resource)
+    {}
+
+    std::pmr::memory_resource* resource() const noexcept override {
+        return _resource;
+    }
+
+protected:
+    void destroy() noexcept override {
+        auto* resource = _resource;
+        this->~resource_node();
+        resource->deallocate(this, sizeof(resource_node), alignof(resource_node));
+    }
+
+private:
+    std::pmr::memory_resource* _resource;
+};
+
+// Allocates a shared state or link from `resource`, or from the default heap
+// when there is none.
+template <typename Node, typename... Args>
+intrusive_ptr<Node> allocate_intrusive(std::pmr::memory_resource* resource, Args&&... args) {
+    if (!resource) {
+        return make_intrusive<Node>(std::forward<Args>(args)...);
+    }
+    void* memory = resource->allocate(sizeof(resource_node<Node>), alignof(resource_node<Node>));
+#if defined(__cpp_exceptions)
+    try {
+        return intrusive_ptr<Node>(::new (memory) resource_node<Node>(resource, std::forward<Args>(args)...));
+    } catch (...) {
+        resource->deallocate(memory, sizeof(resource_node<Node>), alignof(resource_node<Node>));
+        throw;
+    }
+#else
+    return intrusive_ptr<Node>(::new (memory) resource_node<Node>(resource, std::forward<Args>(args)...));
+#endif
+}
 
 template<typename handler_type, typename arg_type, typename error_type> struct resolver;
 
+template <typename> struct is_future_type : std::false_type {};
+template <typename T, typename E> struct is_future_type<future<T, E>> : std::true_type {};
+template <typename T, typename E> struct is_future_type<cancellable_future<T, E>> : std::true_type {};
+
+// Empty first stage of a pipeline.
+struct identity {};
+
+// Two consecutive pipeline stages as one callable: `second` is called with
+// what `first` returns, or with nothing if `first` returns void. A `first`
+// returning expected<R, E> either feeds `second` its value or makes the pair
+// fail with its error, so the pair returns an expected too.
+template <typename First, typename Second>
+struct fused {
+    First first;
+    Second second;
+
+    template <typename... Args>
+    auto operator()(Args&&... args) {
+        using result = std::invoke_result_t<First&, Args&&...>;
+        static_assert(!is_future_type<result>::value, "only the last stage of a pipeline may return a future");
+        if constexpr (std::is_void_v<result>) {
+            first(std::forward<Args>(args)...);
+            return second();
+        } else if constexpr (is_expected_type<result>::value) {
+            return chain(first(std::forward<Args>(args)...));
+        } else {
+            return second(first(std::forward<Args>(args)...));
+        }
+    }
+
+private:
+    template <typename T, typename E>
+    auto chain(expected<T, E>&& input) {
+        auto next = [&]() {
+            if constexpr (std::is_void_v<T>) {
+                return second();
+            } else {
+                return second(*std::move(input));
+            }
+        };
+        using R = decltype(next());
+        if constexpr (is_expected_type<R>::value) {
+            return input ? next() : R(unexpected(std::move(input).error()));
+        } else if constexpr (std::is_void_v<R>) {
+            if (!input) {
+                return expected<R, E>(unexpected(std::move(input).error()));
+            }
+            next();
+            return expected<R, E>();
+        } else {
+            return input ? expected<R, E>(next()) : expected<R, E>(unexpected(std::move(input).error()));
+        }
+    }
+};
+
 template <typename Handler_t, typename I, typename O, typename E>
-class link
-    : public continuation<I, E>
-    , public precursor<O, E>
-    , public std::enable_shared_from_this<link<Handler_t, I, O, E>>
-{
+class link : public precursor<O, E> {
 public:
     link(Handler_t && handler) : _handler(std::forward<Handler_t>(handler)) {}
     link(Handler_t const& handler) : _handler(handler) {}
 
-    void handle(expected<I, E> const& value) override {
+    void handle(expected<I, E> const& value) {
         execute_handler(value);
+        this->release();
     }
 
-    void handle(expected<I, E> && value) override {
+    void handle(expected<I, E> && value) {
         execute_handler(std::move(value));
+        this->release();
+    }
+
+    void discard() noexcept {
+        this->release();
     }
 
 private:
+    using traits = resolver<Handler_t, I, E>;
+
     template <typename T = expected<I, E>>
     void execute_handler(T&& value) {
-        if (value) {
-            execute_handler_impl(std::forward<T>(value));
+        if (!value) {
+            precursor<O, E>::set_value(unexpected(std::forward<T>(value).error()));
+        } else if constexpr (std::is_void_v<I>) {
+            invoke();
         } else {
-            precursor<O, E>::set_value(unexpected(value.error()));
+            invoke(*std::forward<T>(value));
         }
     }
 
-    template <typename T = expected<I, E>, typename II = I>
-    auto execute_handler_impl(T&& value) -> typename std::enable_if_t<!std::is_void_v<II>, void> {
-        if constexpr (!resolver<Handler_t, I, E>::is_future::value) {
+    // With E = std::exception_ptr an exception thrown by the handler becomes
+    // the stage's error. Chains with any other E carry errors by value only and
+    // compile no try block: their handlers fail by returning expected<R, E>,
+    // and must not throw.
+    template <typename... Args>
+    void invoke(Args&&... args) {
+        if constexpr (traits::is_future::value) {
+            _handler(std::forward<Args>(args)...).on_ready([self = precursor_ptr<O, E>::share(this)](auto&& result) {
+                self->set_value(std::forward<decltype(result)>(result));
+            });
+        } else if constexpr (std::is_same_v<std::exception_ptr, E>) {
+#if defined(__cpp_exceptions)
             try {
-                if constexpr (!std::is_void_v<O>) {
-                    precursor<O, E>::set_value(expected<O, E>(_handler(*value)));
-                } else {
-                    _handler(*value);
-                    precursor<O, E>::set_value(expected<O, E>());
-                }
+                complete(std::forward<Args>(args)...);
             } catch (...) {
                 precursor<O, E>::set_value(unexpected(std::current_exception()));
             }
+#else
+            complete(std::forward<Args>(args)...);
+#endif
         } else {
-            if constexpr (!std::is_void_v<O>) {
-                _handler(*value).then([w = link::weak_from_this()](O result) {
-                    if (auto self = w.lock()) {
-                        self->set_value(expected<O, E>(result));
-                    }
-                });
-            } else {
-                _handler(*value).then([w = link::weak_from_this()]() {
-                    if (auto self = w.lock()) {
-                        self->set_value(expected<O, E>());
-                    }
-                });
-            }
+            complete(std::forward<Args>(args)...);
         }
     }
 
-    template <typename T = expected<void, E>, typename II = I>
-    auto execute_handler_impl(T&& value) -> typename std::enable_if_t<std::is_void_v<II>, void> {
-        if constexpr (!resolver<Handler_t, I, E>::is_future::value) {
-            try {
-                if constexpr (!std::is_void_v<O>) {
-                    precursor<O, E>::set_value(expected<O, E>(_handler()));
-                } else {
-                    _handler();
-                    precursor<O, E>::set_value(expected<O, E>());
-                }
-            } catch (...) {
-                precursor<O, E>::set_value(unexpected(std::current_exception()));
-            }
+    template <typename... Args>
+    void complete(Args&&... args) {
+        if constexpr (traits::is_expected::value) {
+            precursor<O, E>::set_value(_handler(std::forward<Args>(args)...));
+        } else if constexpr (std::is_void_v<O>) {
+            _handler(std::forward<Args>(args)...);
+            precursor<O, E>::set_value(expected<O, E>());
         } else {
-            if constexpr (!std::is_void_v<O>) {
-                _handler().then([w = link::weak_from_this()](O result) {
-                    if (auto self = w.lock()) {
-                        self->set_value(expected<O, E>(result));
-                    }
-                });
-            } else {
-                _handler().then([w = link::weak_from_this()]() {
-                    if (auto self = w.lock()) {
-                        self->set_value(expected<O, E>());
-                    }
-                });
-            }
+            precursor<O, E>::set_value(expected<O, E>(_handler(std::forward<Args>(args)...)));
         }
     }
 
+protected:
     Handler_t _handler;
 };
 
+// Continuation that hands its handler to an executor instead of running it on
+// the producing thread. The link is its own task, so scheduling allocates
+// nothing beyond the link; the input is parked in the link until it runs.
+template <typename Handler_t, typename I, typename O, typename E>
+class scheduled_link
+    : public link<Handler_t, I, O, E>
+    , public task
+{
+public:
+    template <typename H>
+    scheduled_link(H&& handler, Executor& executor, schedule policy)
+        : link<Handler_t, I, O, E>(std::forward<H>(handler))
+        , _executor(executor)
+        , _policy(policy)
+    {}
+
+    void handle(expected<I, E> const& value) {
+        _input = value;
+        submit();
+    }
+
+    void handle(expected<I, E> && value) {
+        _input = std::move(value);
+        submit();
+    }
+
+    void run() override {
+        link<Handler_t, I, O, E>::handle(std::move(*_input));
+    }
+
+private:
+    // The reference handed over by the upstream state travels with the task.
+    void submit() {
+        _executor.submit(*this, _policy);
+    }
+
+    Executor& _executor;
+    schedule _policy;
+    optional<expected<I, E>> _input;
+};
+
 
-template<typename T, typename E> struct extract_future_type { typedef T value_type; typedef E error_type; typedef std::false_type is_future; };
-template<typename T, typename E> struct extract_future_type<future<T, E>, E> { typedef T value_type; typedef E error_type; typedef std::true_type is_future; };
-template<typename T, typename E> struct extract_future_type<cancellable_future<T, E>, E> { typedef T value_type; typedef E error_type; typedef std::true_type is_future; };
+template<typename T, typename E> struct extract_future_type { typedef T value_type; typedef E error_type; typedef std::false_type is_future; typedef std::false_type is_expected; };
+template<typename T, typename E> struct extract_future_type<future<T, E>, E> { typedef T value_type; typedef E error_type; typedef std::true_type is_future; typedef std::false_type is_expected; };
+template<typename T, typename E> struct extract_future_type<cancellable_future<T, E>, E> { typedef T value_type; typedef E error_type; typedef std::true_type is_future; typedef std::false_type is_expected; };
+template<typename T, typename E> struct extract_future_type<expected<T, E>, E> { typedef T value_type; typedef E error_type; typedef std::false_type is_future; typedef std::true_type is_expected; };
 
 template<typename handler_type, typename arg_type, typename error_type>
 struct resolver {
     using raw_return_type = decltype(std::declval<handler_type>()(std::declval<arg_type>()));
     using return_type = typename extract_future_type<raw_return_type, error_type>::value_type;
     using is_future = typename extract_future_type<raw_return_type, error_type>::is_future;
+    using is_expected = typename extract_future_type<raw_return_type, error_type>::is_expected;
 
     template <typename F>
-    static auto make_continuation(F&& handler) {
-        return std::make_shared<details::link<handler_type, arg_type, return_type, error_type>>(handler);
+    static auto make_continuation(std::pmr::memory_resource* resource, F&& handler) {
+        return allocate_intrusive<details::link<handler_type, arg_type, return_type, error_type>>(resource, std::forward<F>(handler));
+    }
+
+    template <typename F>
+    static auto make_continuation(std::pmr::memory_resource* resource, F&& handler, Executor& executor, schedule policy) {
+        return allocate_intrusive<details::scheduled_link<handler_type, arg_type, return_type, error_type>>(resource, std::forward<F>(handler), executor, policy);
     }
 };
 
@@ -222,10 +886,141 @@ struct resolver<handler_type, void, error_type> {
     using raw_return_type = decltype(std::declval<handler_type>()());
     using return_type = typename extract_future_type<raw_return_type, error_type>::value_type;
     using is_future = typename extract_future_type<raw_return_type, error_type>::is_future;
+    using is_expected = typename extract_future_type<raw_return_type, error_type>::is_expected;
 
     template <typename F>
-    static auto make_continuation(F&& handler) {
-        return std::make_shared<details::link<handler_type, void, return_type, error_type>>(handler);
+    static auto make_continuation(std::pmr::memory_resource* resource, F&& handler) {
+        return allocate_intrusive<details::link<handler_type, void, return_type, error_type>>(resource, std::forward<F>(handler));
+    }
+
+    template <typename F>
+    static auto make_continuation(std::pmr::memory_resource* resource, F&& handler, Executor& executor, schedule policy) {
+        return allocate_intrusive<details::scheduled_link<handler_type, void, return_type, error_type>>(resource, std::forward<F>(handler), executor, policy);
+    }
+};
+
+// Awaiting a future suspends the coroutine and installs the awaiter itself,
+// which lives in the coroutine frame, as the continuation. Nothing is
+// allocated, and a value that is already there, or arrives while suspending,
+// lets the coroutine continue without being suspended at all.
+template <typename T, typename E>
+class future_awaiter final {
+public:
+    explicit future_awaiter(precursor_ptr<T, E> state) : _state(std::move(state)) {}
+
+    bool await_ready() const noexcept {
+        return !!*_state;
+    }
+
+    bool await_suspend(std::coroutine_handle<> coroutine) {
+        _coroutine = coroutine;
+        return _state->attach(this);
+    }
+
+    // The value is moved out only if no future shares the state with us.
+    T await_resume() {
+        if constexpr (std::is_void_v<T>) {
+            *_state->get();
+        } else if (_state->unshared()) {
+            return *std::move(_state->get());
+        } else {
+            return *std::as_const(*_state).get();
+        }
+    }
+
+    void handle(expected<T, E> const&) {
+        _coroutine.resume();
+    }
+
+    void handle(expected<T, E> &&) {
+        _coroutine.resume();
+    }
+
+    void discard() noexcept {}
+
+    std::coroutine_handle<> coroutine() const noexcept {
+        return _coroutine;
+    }
+
+private:
+    precursor_ptr<T, E> _state;
+    std::coroutine_handle<> _coroutine;
+};
+
+// Promise type of coroutines returning future<T, E>. The result is published
+// from the final suspend point, where the frame is destroyed and an awaiting
+// coroutine is resumed by symmetric transfer, so arbitrarily long chains of
+// coroutines awaiting each other run in constant stack.
+template <typename T, typename E>
+class coroutine_promise_base {
+public:
+    using value_type = expected<T, E>;
+
+    future<T, E> get_return_object() {
+        return future<T, E>(_state);
+    }
+
+    std::suspend_never initial_suspend() noexcept {
+        return {};
+    }
+
+    struct final_awaiter {
+        bool await_ready() noexcept {
+            return false;
+        }
+
+        template <typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> coroutine) noexcept {
+            coroutine_promise_base& self = coroutine.promise();
+            auto state = std::move(self._state);
+            auto result = std::move(*self._result);
+            coroutine.destroy();
+            return state->set_value_and_transfer(std::move(result));
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    final_awaiter final_suspend() noexcept {
+        return {};
+    }
+
+    // Errors of a non-exception_ptr E are returned with co_return unexpected(e);
+    // an exception escaping such a coroutine has nowhere to go.
+    void unhandled_exception() {
+        if constexpr (std::is_same_v<std::exception_ptr, E>) {
+            _result = value_type(unexpected(std::current_exception()));
+        } else {
+            std::terminate();
+        }
+    }
+
+protected:
+    precursor_ptr<T, E> _state = make_intrusive<precursor<T, E>>();
+    optional<value_type> _result;
+};
+
+template <typename T, typename E>
+class coroutine_promise : public coroutine_promise_base<T, E> {
+public:
+    void return_value(T const& v) {
+        this->_result = expected<T, E>(v);
+    }
+
+    void return_value(T&& v) {
+        this->_result = expected<T, E>(std::move(v));
+    }
+
+    void return_value(unexpected<E> e) {
+        this->_result = expected<T, E>(std::move(e));
+    }
+};
+
+template <typename E>
+class coroutine_promise<void, E> : public coroutine_promise_base<void, E> {
+public:
+    void return_void() {
+        this->_result = expected<void, E>();
     }
 };
 
@@ -235,6 +1030,7 @@ template <typename T, typename E>
 class future {
 public:
     using value_type = expected<T, E>;
+    using promise_type = details::coroutine_promise<T, E>;
 
     explicit future() {}
     explicit future(details::precursor_ptr<T, E> value) : _value(std::move(value)) {}
@@ -260,22 +1056,235 @@ public:
         return _value->get(duration);
     }
 
+    // A single acquire load; never blocks.
+    bool is_ready() const noexcept {
+        return _value && !!*_value;
+    }
+
+    // The stored result, or null if it has not arrived yet. Nothing is copied
+    // and nothing blocks, which is what event loops polling many futures per
+    // tick need; the result lives as long as the future does.
+    value_type const* try_get() const noexcept {
+        return _value ? _value->try_get() : nullptr;
+    }
+
+    // Waits for the result and returns it as is, without throwing a failure;
+    // the way to read chains with a typed error, and builds without exceptions.
+    value_type const& result() const {
+        return _value->get();
+    }
+
+    details::future_awaiter<T, E> operator co_await() const& {
+        return details::future_awaiter<T, E>(_value);
+    }
+
+    details::future_awaiter<T, E> operator co_await() && {
+        return details::future_awaiter<T, E>(std::move(_value));
+    }
+
+    // Sets the executor that runs continuations attached through then(F) on
+    // this future and on the futures it returns. Without one, continuations run
+    // inline on whichever thread fulfils the value.
+    future& via(Executor& executor, schedule policy = schedule::post) & {
+        _executor = &executor;
+        _policy = policy;
+        return *this;
+    }
+
+    future&& via(Executor& executor, schedule policy = schedule::post) && {
+        return std::move(via(executor, policy));
+    }
+
+    // then() and on_ready() on an rvalue future give up its claim on the value:
+    // once no other future shares the state, the value is moved into the
+    // handler rather than copied, so a chain built from temporaries carries its
+    // value from the producer to the last handler without copying it. On an
+    // lvalue the value stays readable through get() and handlers see a copy.
+    template<typename F, typename R = typename details::resolver<F, T, E>::return_type>
+    future<R, E> then(F&& handler) & {
+        return then_impl(std::forward<F>(handler), false);
+    }
+
+    template<typename F, typename R = typename details::resolver<F, T, E>::return_type>
+    future<R, E> then(F&& handler) && {
+        return then_impl(std::forward<F>(handler), true);
+    }
+
+    // Calls `handler` with the expected result, on whichever thread fulfils
+    // the value, without creating a downstream future. The handler is kept in
+    // the shared state itself and takes the result by value or by const
+    // reference; one capturing up to three pointers costs no allocation.
+    template <typename F>
+    void on_ready(F&& handler) & {
+        _value->set_callback(std::forward<F>(handler));
+    }
+
+    template <typename F>
+    void on_ready(F&& handler) && {
+        _value->set_callback(std::forward<F>(handler), true);
+    }
+
+    // Starts a pipeline of synchronous stages that are fused into a single
+    // continuation; see pipeline.
+    pipeline<future, details::identity> pipe() const& {
+        return pipeline<future, details::identity>(future(*this), details::identity());
+    }
+
+    pipeline<future, details::identity> pipe() && {
+        return pipeline<future, details::identity>(std::move(*this), details::identity());
+    }
+
+    // Schedules the handler on `executor` using this future's policy; the
+    // returned future keeps this future's own executor settings.
     template<typename F, typename R = typename details::resolver<F, T, E>::return_type>
-    future<R, E> then(F&& handler) {
-        auto cont = details::resolver<F, T, E>::make_continuation(std::forward<F>(handler));
-        _value->set_continuation(std::static_pointer_cast<details::continuation<T, E>>(cont));
-        return future<R, E>(cont);
+    future<R, E> then(Executor& executor, F&& handler) & {
+        return then_impl(executor, std::forward<F>(handler), false);
+    }
+
+    template<typename F, typename R = typename details::resolver<F, T, E>::return_type>
+    future<R, E> then(Executor& executor, F&& handler) && {
+        return then_impl(executor, std::forward<F>(handler), true);
     }
 
 private:
+    template <typename, typename> friend class future;
+    template <typename, typename> friend class cancellable_future;
+    friend struct details::future_access;
+
+    template<typename F, typename R = typename details::resolver<F, T, E>::return_type>
+    future<R, E> then_impl(F&& handler, bool consume) {
+        if (_executor) {
+            return then_impl(*_executor, std::forward<F>(handler), consume);
+        }
+        auto cont = details::resolver<std::decay_t<F>, T, E>::make_continuation(_value->resource(), std::forward<F>(handler));
+        cont->add_ref();
+        _value->set_continuation(cont.get(), consume);
+        return inherit(future<R, E>(std::move(cont)));
+    }
+
+    template<typename F, typename R = typename details::resolver<F, T, E>::return_type>
+    future<R, E> then_impl(Executor& executor, F&& handler, bool consume) {
+        auto cont = details::resolver<std::decay_t<F>, T, E>::make_continuation(_value->resource(), std::forward<F>(handler), executor, _policy);
+        cont->add_ref();
+        _value->set_continuation(cont.get(), consume);
+        return inherit(future<R, E>(std::move(cont)));
+    }
+
+    template <typename R>
+    future<R, E> inherit(future<R, E>&& next) const {
+        next._executor = _executor;
+        next._policy = _policy;
+        return std::move(next);
+    }
+
     details::precursor_ptr<T, E> _value;
+    Executor* _executor = nullptr;
+    schedule _policy = schedule::post;
 };
 
+// Appends to `ready` the indices of the futures in `futures` whose result has
+// arrived and returns how many there were. Reusing `ready` across calls keeps
+// polling allocation-free.
+template <typename Future, std::size_t N>
+std::size_t poll_ready(std::span<Future, N> futures, std::vector<std::size_t>& ready) {
+    const auto before = ready.size();
+    for (std::size_t i = 0; i < futures.size(); ++i) {
+        if (futures[i].is_ready()) {
+            ready.push_back(i);
+        }
+    }
+    return ready.size() - before;
+}
+
+template <typename Range>
+std::size_t poll_ready(Range& futures, std::vector<std::size_t>& ready) {
+    return poll_ready(std::span(futures), ready);
+}
+
+// Builder for a chain of synchronous stages that runs as one continuation.
+//
+// then() on a pipeline attaches nothing: it composes the handler with the
+// stages before it into a single callable, and the pipeline becomes a future
+// when converted to one or when end() is called. However many stages there
+// are, that costs one link and one dispatch, where a then() chain costs one
+// of each per stage. A handler that throws skips the stages after it, and the
+// pipeline completes with the error, as the chain would. Only the last stage
+// may return a future; after one, end the pipeline and continue with then().
+template <typename Source, typename F>
+class pipeline {
+public:
+    pipeline(Source&& source, F&& stages)
+        : _source(std::move(source))
+        , _stages(std::move(stages))
+    {}
+
+    template <typename G>
+    auto then(G&& handler) && {
+        using stage = std::decay_t<G>;
+        if constexpr (std::is_same_v<F, details::identity>) {
+            return pipeline<Source, stage>(std::move(_source), stage(std::forward<G>(handler)));
+        } else {
+            using fused = details::fused<F, stage>;
+            return pipeline<Source, fused>(std::move(_source), fused{std::move(_stages), stage(std::forward<G>(handler))});
+        }
+    }
+
+    auto end() && {
+        if constexpr (std::is_same_v<F, details::identity>) {
+            return std::move(_source);
+        } else {
+            return std::move(_source).then(std::move(_stages));
+        }
+    }
+
+    template <typename R, typename E>
+    operator future<R, E>() && {
+        return std::move(*this).end();
+    }
+
+private:
+    Source _source;
+    F _stages;
+};
+
+// Continuations that become runnable while another one is running on the same
+// thread run nested on its stack up to this depth; beyond it they are deferred
+// to current_executor(), or, on a thread running no executor's work, queued
+// and run by the outermost one as it returns, or by a get() on that thread
+// that would otherwise block. The default is 64. A handler blocking on a
+// continuation deferred to an executor needs another thread of the executor
+// to run it.
+inline std::size_t inline_continuation_depth() noexcept {
+    return details::trampoline::inline_depth();
+}
+
+inline void set_inline_continuation_depth(std::size_t depth) noexcept {
+    details::trampoline::set_inline_depth(depth);
+}
+
+namespace details {
+
+// Lets combinators defined outside this header reach a future's shared state.
+struct future_access {
+    template <typename T, typename E>
+    static precursor_ptr<T, E> const& state(future<T, E> const& f) {
+        return f._value;
+    }
+};
+
+} // namespace details
+
 template <typename T, typename E = std::exception_ptr>
 class promise {
 public:
-    explicit promise() : _vc(std::make_shared<details::precursor<T,E>>()) {}
-    promise(promise&& o) : _vc(std::move(o._continuation)) {}
+    explicit promise() : _vc(details::make_intrusive<details::precursor<T,E>>()) {}
+
+    // The shared state, and every link then() attaches downstream of it, is
+    // allocated from the allocator's memory resource.
+    promise(std::allocator_arg_t, std::pmr::polymorphic_allocator<std::byte> const& allocator)
+        : _vc(details::allocate_intrusive<details::precursor<T,E>>(allocator.resource())) {}
+
+    promise(promise&& o) : _vc(std::move(o._vc)) {}
 
     void set_value(T&& v) {
         assert(_vc);
@@ -288,22 +1297,24 @@ public:
     }
 
     void set_exception(E&& e) {
-        assert(!_vc);
+        assert(_vc && !*_vc);
         _vc->set_value(unexpected(std::forward<E>(e)));
     }
 
     void set_exception(E const& e) {
-        assert(!_vc);
+        assert(_vc && !*_vc);
         _vc->set_value(unexpected(e));
     }
 
+    // Exceptions are captured into an exception_ptr; anything else is
+    // converted to E.
     template <typename EE = E>
     void set_exception(EE&& e) {
-        assert(!*_vc);
-        if constexpr (std::is_base_of_v<std::exception, EE> && std::is_same_v<std::exception_ptr, E>) {
-            _vc->set_value(unexpected(std::make_exception_ptr(e)));
+        assert(_vc && !*_vc);
+        if constexpr (std::is_base_of_v<std::exception, std::decay_t<EE>> && std::is_same_v<std::exception_ptr, E>) {
+            _vc->set_value(unexpected(std::make_exception_ptr(std::forward<EE>(e))));
         } else {
-            _vc->set_value(unexpected(std::forward<E>(e)));
+            _vc->set_value(unexpected<E>(E(std::forward<EE>(e))));
         }
     }
 
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <type_traits>
+
+namespace hntr::platform {
+
+// Opt-in description of representations a type never uses, which optional
+// and expected use to keep their discriminant inside the payload instead of
+// in a separate flag: optional<T> becomes the size of T, and expected<T, E>
+// the size of T when T has spare bits to carry E.
+//
+// Specialise niche<T> for a type of your own, usually by deriving from
+// sentinel_niche, to give optional<T> an empty state:
+//
+//     enum class index_t : std::uint32_t {};
+//     template <> struct niche<index_t> : sentinel_niche<index_t, index_t(~0u)> {};
+//
+// Prefer a distinct type over an alias of a built-in one, as the
+// specialisation applies to every use of the type. Like any specialisation it
+// must be seen before the first use of optional<T> or expected<T, E>, in
+// every translation unit; nothing is opted in implicitly.
+template <typename T>
+struct niche {};
+
+// A single value that is never a valid T. Providing none() and is_none() is
+// all optional needs.
+template <typename T, T Sentinel>
+struct sentinel_niche {
+    static constexpr T none() noexcept {
+        return Sentinel;
+    }
+
+    static constexpr bool is_none(T const& v) noexcept {
+        return v == Sentinel;
+    }
+};
+
+// Pointers to objects aligned to two bytes or more never have the lowest bit
+// set. Opt a pointer type in where the pointee is complete:
+//
+//     template <> struct niche<node*> : pointer_niche<node*> {};
+//
+// Besides the empty state for optional, that bit then tags an error which
+// expected keeps in the rest of the pointer.
+template <typename P>
+struct pointer_niche;
+
+template <typename T>
+struct pointer_niche<T*> {
+    static_assert(alignof(T) >= 2, "pointers to bytes have no spare bit");
+
+    // The first byte of every valid value has its lowest bit clear.
+    static constexpr bool low_bit_free = true;
+
+    static T* none() noexcept {
+        return reinterpret_cast<T*>(std::uintptr_t(1));
+    }
+
+    static bool is_none(T* const& p) noexcept {
+        return reinterpret_cast<std::uintptr_t>(p) & 1;
+    }
+};
+
+namespace details {
+
+template <typename T>
+concept has_niche = std::is_trivially_copyable_v<T> && requires (T const& v) {
+    { niche<T>::none() } -> std::same_as<T>;
+    { niche<T>::is_none(v) } -> std::same_as<bool>;
+};
+
+// An error kept in the storage of a T: the tag byte overlays the first byte
+// of T, the error follows it.
+template <typename E>
+struct tagged_error {
+    unsigned char tag;
+    E error;
+};
+
+// E fits beside the tag bit when tag and error together are no larger than
+// T. The lowest bit of the first byte is the lowest bit of the word on
+// little-endian targets only.
+template <typename T, typename E>
+concept niche_carries = has_niche<T>
+    && requires { requires niche<T>::low_bit_free; }
+    && std::endian::native == std::endian::little
+    && std::is_trivially_copyable_v<E>
+    && sizeof(tagged_error<E>) <= sizeof(T)
+    && alignof(tagged_error<E>) <= alignof(T);
+
+} // namespace details
+
+}
@@ -0,0 +1,295 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace hntr::platform {
+
+struct node_pool_stats {
+    std::uint64_t allocations = 0;  // requests served by the pool
+    std::uint64_t cache_hits = 0;   // of which taken straight from the thread's cache
+    std::uint64_t oversized = 0;    // requests above the largest size class, passed to operator new
+    std::size_t reserved_bytes = 0; // obtained from operator new for size classes
+    std::size_t free_bytes = 0;     // of which sitting in thread caches and the depot
+
+    double hit_rate() const {
+        return allocations ? static_cast<double>(cache_hits) / static_cast<double>(allocations) : 0.0;
+    }
+
+    std::size_t used_bytes() const {
+        return reserved_bytes - free_bytes;
+    }
+};
+
+// Recycling allocator for chain nodes, enabled by defining
+// HNTR_PLATFORM_NODE_POOL; without it nodes come from the global allocator.
+//
+// Requests are rounded up to one of a few size classes. Each thread keeps a
+// free list per class and serves allocations and frees from it without any
+// synchronisation; a node freed on another thread than it was allocated on
+// simply joins the freeing thread's list. Lists exchange whole batches with
+// a global depot when they run dry or grow too long, which is the only place a
+// lock is taken, once per batch. Memory is carved from slabs that are kept for
+// the lifetime of the process.
+class node_pool {
+public:
+    static constexpr std::size_t granularity = 16;
+    static constexpr std::size_t max_node_size = 512;
+    static constexpr std::size_t classes = max_node_size / granularity;
+    static constexpr std::size_t batch_size = 32;
+
+    static void* allocate(std::size_t size) {
+        if (size > max_node_size) {
+            if (!_cache_gone) {
+                cache().count_oversized();
+            }
+            return ::operator new(size);
+        }
+        if (_cache_gone) {
+            return depot().pop_one(class_of(size));
+        }
+        return cache().pop(class_of(size));
+    }
+
+    static void deallocate(void* p, std::size_t size) noexcept {
+        if (size > max_node_size) {
+            ::operator delete(p);
+            return;
+        }
+        if (_cache_gone) {
+            depot().push_one(class_of(size), p);
+            return;
+        }
+        cache().push(class_of(size), p);
+    }
+
+    static node_pool_stats stats() {
+        return depot().stats();
+    }
+
+private:
+    struct free_node {
+        free_node* next;
+        free_node* next_batch;
+    };
+
+    static constexpr std::size_t class_of(std::size_t size) {
+        return size ? (size - 1) / granularity : 0;
+    }
+
+    static constexpr std::size_t class_size(std::size_t c) {
+        return (c + 1) * granularity;
+    }
+
+    class thread_cache;
+
+    class global_depot {
+    public:
+        // Returns a chain of free nodes and stores its length in `count`.
+        free_node* pop_batch(std::size_t c, std::size_t& count) {
+            {
+                std::lock_guard lock(_mutex);
+                if (auto* batch = _batches[c]) {
+                    _batches[c] = batch->next_batch;
+                    count = 0;
+                    for (auto* n = batch; n; n = n->next) {
+                        ++count;
+                    }
+                    _free_bytes -= count * class_size(c);
+                    return batch;
+                }
+            }
+            count = batch_size;
+            return carve(c);
+        }
+
+        void push_batch(std::size_t c, free_node* batch, std::size_t count) {
+            std::lock_guard lock(_mutex);
+            batch->next_batch = _batches[c];
+            _batches[c] = batch;
+            _free_bytes += count * class_size(c);
+        }
+
+        // Used once the calling thread's cache has been torn down.
+        void* pop_one(std::size_t c) {
+            std::size_t count;
+            auto* batch = pop_batch(c, count);
+            if (batch->next) {
+                push_batch(c, batch->next, count - 1);
+            }
+            return batch;
+        }
+
+        void push_one(std::size_t c, void* p) {
+            auto* node = static_cast<free_node*>(p);
+            node->next = nullptr;
+            push_batch(c, node, 1);
+        }
+
+        void enlist(thread_cache* cache) {
+            std::lock_guard lock(_mutex);
+            _caches.push_back(cache);
+        }
+
+        void retire(thread_cache* cache) {
+            std::lock_guard lock(_mutex);
+            _retired.allocations += cache->allocations.load(std::memory_order_relaxed);
+            _retired.cache_hits += cache->cache_hits.load(std::memory_order_relaxed);
+            _retired.oversized += cache->oversized.load(std::memory_order_relaxed);
+            for (auto& c : _caches) {
+                if (c == cache) {
+                    c = _caches.back();
+                    _caches.pop_back();
+                    break;
+                }
+            }
+        }
+
+        node_pool_stats stats() {
+            std::lock_guard lock(_mutex);
+            auto s = _retired;
+            s.reserved_bytes = _reserved_bytes;
+            s.free_bytes = _free_bytes;
+            for (auto* cache : _caches) {
+                s.allocations += cache->allocations.load(std::memory_order_relaxed);
+                s.cache_hits += cache->cache_hits.load(std::memory_order_relaxed);
+                s.oversized += cache->oversized.load(std::memory_order_relaxed);
+                s.free_bytes += cache->free_bytes.load(std::memory_order_relaxed);
+            }
+            return s;
+        }
+
+    private:
+        free_node* carve(std::size_t c) {
+            const auto size = class_size(c);
+            auto* slab = static_cast<char*>(::operator new(size * batch_size));
+            for (std::size_t i = 0; i < batch_size; ++i) {
+                auto* node = reinterpret_cast<free_node*>(slab + i * size);
+                node->next = i + 1 < batch_size ? reinterpret_cast<free_node*>(slab + (i + 1) * size) : nullptr;
+            }
+            std::lock_guard lock(_mutex);
+            _slabs.push_back(slab);
+            _reserved_bytes += size * batch_size;
+            return reinterpret_cast<free_node*>(slab);
+        }
+
+        std::mutex _mutex;
+        free_node* _batches[classes] = {};
+        std::vector<void*> _slabs;
+        std::size_t _reserved_bytes = 0;
+        std::size_t _free_bytes = 0;
+        std::vector<thread_cache*> _caches;
+        node_pool_stats _retired;
+    };
+
+    // Counters are only written by the owning thread; they are atomics so that
+    // stats() can read them from elsewhere.
+    class thread_cache {
+    public:
+        thread_cache() {
+            depot().enlist(this);
+        }
+
+        ~thread_cache() {
+            for (std::size_t c = 0; c < classes; ++c) {
+                if (_bins[c].head) {
+                    depot().push_batch(c, _bins[c].head, _bins[c].count);
+                }
+            }
+            depot().retire(this);
+            _cache_gone = true;
+        }
+
+        void* pop(std::size_t c) {
+            auto& bin = _bins[c];
+            bump(allocations);
+            if (bin.head) {
+                bump(cache_hits);
+            } else {
+                bin.head = depot().pop_batch(c, bin.count);
+                add_free(bin.count * class_size(c));
+            }
+            auto* node = bin.head;
+            bin.head = node->next;
+            --bin.count;
+            remove_free(class_size(c));
+            return node;
+        }
+
+        void push(std::size_t c, void* p) {
+            auto& bin = _bins[c];
+            auto* node = static_cast<free_node*>(p);
+            node->next = bin.head;
+            bin.head = node;
+            ++bin.count;
+            add_free(class_size(c));
+            if (bin.count >= 2 * batch_size) {
+                flush(c);
+            }
+        }
+
+        void count_oversized() {
+            bump(oversized);
+        }
+
+        std::atomic<std::uint64_t> allocations{0};
+        std::atomic<std::uint64_t> cache_hits{0};
+        std::atomic<std::uint64_t> oversized{0};
+        std::atomic<std::size_t> free_bytes{0};
+
+    private:
+        struct bin {
+            free_node* head = nullptr;
+            std::size_t count = 0;
+        };
+
+        // Hands the oldest batch_size nodes to the depot and keeps the most
+        // recently freed ones, which are the likeliest to still be in cache.
+        void flush(std::size_t c) {
+            auto& bin = _bins[c];
+            auto* last_kept = bin.head;
+            for (std::size_t i = 1; i < bin.count - batch_size; ++i) {
+                last_kept = last_kept->next;
+            }
+            auto* batch = last_kept->next;
+            last_kept->next = nullptr;
+            bin.count -= batch_size;
+            remove_free(batch_size * class_size(c));
+            depot().push_batch(c, batch, batch_size);
+        }
+
+        static void bump(std::atomic<std::uint64_t>& counter) {
+            counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        void add_free(std::size_t bytes) {
+            free_bytes.store(free_bytes.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+        }
+
+        void remove_free(std::size_t bytes) {
+            free_bytes.store(free_bytes.load(std::memory_order_relaxed) - bytes, std::memory_order_relaxed);
+        }
+
+        bin _bins[classes];
+    };
+
+    // Never destroyed, so nodes freed during static destruction still have
+    // somewhere to go.
+    static global_depot& depot() {
+        static global_depot* instance = new global_depot();
+        return *instance;
+    }
+
+    static thread_cache& cache() {
+        static thread_local thread_cache instance;
+        return instance;
+    }
+
+    static inline thread_local bool _cache_gone = false;
+};
+
+}
@@ -1,10 +1,28 @@
 #pragma once
 
 #include <utility>
+#include <cassert>
+#include <cstdlib>
 #include <exception>
+#include <new>
+#include <stdexcept>
+
+#include "niche.hpp"
 
 namespace hntr::platform {
 
+namespace details {
+
+[[noreturn]] inline void bad_optional_access() {
+#if defined(__cpp_exceptions)
+    throw std::runtime_error("bad optional access");
+#else
+    std::abort();
+#endif
+}
+
+} // namespace details
+
 template <typename T>
 class optional {
 public:
@@ -12,16 +30,20 @@ public:
     optional(T const& v) : _value(v) {}
     optional(T && v) : _value(std::forward<T>(v)) {}
 
-    optional operator= (optional<T> const& o) {
+    optional& operator= (optional<T> const& o) {
+        if (this == &o) return *this;
         destroy();
         _ok = o._ok;
-        new(&_value) T(o._value);
+        if (_ok) new(&_value) T(o._value);
+        return *this;
     }
 
-    optional operator= (optional<T>&& o) {
+    optional& operator= (optional<T>&& o) {
+        if (this == &o) return *this;
         destroy();
-        _ok = std::move(o._ok);
-        if(_ok) new(&_value) T(std::move(o._value));
+        _ok = o._ok;
+        if (_ok) new(&_value) T(std::move(o._value));
+        return *this;
     }
 
     optional& operator= (T const& v) {
@@ -50,28 +72,33 @@ public:
 
     T&& operator* () && {
         assert(_ok);
-        return _value;
+        return std::move(_value);
     }
 
     T const& value() const& {
         if (_ok) return _value;
-        throw std::runtime_error("bad optional access");
+        details::bad_optional_access();
     }
 
     T& value() & {
         if(_ok) return _value;
-        throw std::runtime_error("bad optional access");
+        details::bad_optional_access();
     }
 
     T&& value() && {
         assert(_ok);
-        return _value;
+        return std::move(_value);
     }
 
     operator bool() const {
         return _ok;
     }
 
+    void reset() {
+        destroy();
+        _ok = false;
+    }
+
     ~optional() {
         destroy();
     }
@@ -85,4 +112,64 @@ private:
     union { T _value; };
 };
 
-}
\ No newline at end of file
+// optional of a type with a niche (see niche.hpp): the empty state is the
+// niche value itself, so the optional is the size of T.
+template <typename T>
+    requires details::has_niche<T>
+class optional<T> {
+public:
+    constexpr optional() noexcept : _value(niche<T>::none()) {}
+
+    constexpr optional(T const& v) : _value(v) {
+        assert(!niche<T>::is_none(v));
+    }
+
+    constexpr optional& operator= (T const& v) {
+        assert(!niche<T>::is_none(v));
+        _value = v;
+        return *this;
+    }
+
+    constexpr T const& operator* () const& {
+        assert(*this);
+        return _value;
+    }
+
+    constexpr T& operator* () & {
+        assert(*this);
+        return _value;
+    }
+
+    constexpr T&& operator* () && {
+        assert(*this);
+        return std::move(_value);
+    }
+
+    constexpr T const& value() const& {
+        if (!*this) details::bad_optional_access();
+        return _value;
+    }
+
+    constexpr T& value() & {
+        if (!*this) details::bad_optional_access();
+        return _value;
+    }
+
+    constexpr T&& value() && {
+        assert(*this);
+        return std::move(_value);
+    }
+
+    constexpr operator bool() const {
+        return !niche<T>::is_none(_value);
+    }
+
+    constexpr void reset() {
+        _value = niche<T>::none();
+    }
+
+private:
+    T _value;
+};
+
+}
@@ -0,0 +1,274 @@
+#pragma once
+
+#include "future.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+
+namespace hntr::platform {
+
+namespace details {
+
+// Reports a descriptor the queue could not create. Built without exceptions
+// a queue without its descriptor is of no use, so it is fatal.
+[[noreturn]] inline void ready_queue_failure(char const* what) {
+#if defined(__cpp_exceptions)
+    throw std::system_error(errno, std::generic_category(), what);
+#else
+    (void)what;
+    std::abort();
+#endif
+}
+
+// Shared between a ready_queue and the callbacks it installs, so a callback
+// firing after the queue is gone still has somewhere to go.
+//
+// Ready ids travel through a bounded lock-free ring; the queue admits no more
+// watched futures than the ring holds, so it never overflows. A producer
+// signals the descriptor only if it is the first since the consumer last
+// drained, so a burst of fulfilments costs one wake-up.
+class ready_core {
+public:
+    explicit ready_core(std::size_t capacity)
+        : _mask(round_up(capacity) - 1)
+        , _cells(new cell[_mask + 1])
+    {
+        for (std::size_t i = 0; i <= _mask; ++i) {
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+#if defined(__linux__)
+        _read_fd = _write_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (_read_fd < 0) {
+            ready_queue_failure("eventfd");
+        }
+#else
+        int fds[2];
+        if (::pipe(fds) != 0) {
+            ready_queue_failure("pipe");
+        }
+        for (int fd : fds) {
+            ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+            ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+        _read_fd = fds[0];
+        _write_fd = fds[1];
+#endif
+    }
+
+    ready_core(ready_core const&) = delete;
+    ready_core& operator= (ready_core const&) = delete;
+
+    ~ready_core() {
+        ::close(_read_fd);
+        if (_write_fd != _read_fd) {
+            ::close(_write_fd);
+        }
+    }
+
+    void add_ref() noexcept {
+        _refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release() noexcept {
+        if (_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    int fd() const noexcept {
+        return _read_fd;
+    }
+
+    std::size_t capacity() const noexcept {
+        return _mask + 1;
+    }
+
+    bool admit() noexcept {
+        auto n = _outstanding.load(std::memory_order_relaxed);
+        do {
+            if (n == capacity()) {
+                return false;
+            }
+        } while (!_outstanding.compare_exchange_weak(n, n + 1, std::memory_order_relaxed));
+        return true;
+    }
+
+    void retire(std::size_t n) noexcept {
+        _outstanding.fetch_sub(n, std::memory_order_relaxed);
+    }
+
+    // Producer side, any thread.
+    void push(std::uint64_t id) noexcept {
+        auto pos = _tail.load(std::memory_order_relaxed);
+        for (;;) {
+            auto& c = _cells[pos & _mask];
+            const auto seq = c.sequence.load(std::memory_order_acquire);
+            if (seq == pos) {
+                if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    c.id = id;
+                    c.sequence.store(pos + 1, std::memory_order_release);
+                    break;
+                }
+            } else {
+                // Admission keeps the ring from filling up, so a cell that is
+                // not free yet has just been claimed by another producer.
+                assert(seq > pos);
+                pos = _tail.load(std::memory_order_relaxed);
+            }
+        }
+        if (!_signalled.exchange(true, std::memory_order_acq_rel)) {
+            signal();
+        }
+    }
+
+    // Consumer side, one thread. Clears the signal before draining: either a
+    // producer sees it cleared and signals again, or this exchange reads the
+    // producer's flag and with it the id it pushed.
+    template <typename F>
+    std::size_t drain(F& fn) {
+        clear();
+        _signalled.exchange(false, std::memory_order_acq_rel);
+        std::size_t n = 0;
+        for (;;) {
+            auto& c = _cells[_head & _mask];
+            if (c.sequence.load(std::memory_order_acquire) != _head + 1) {
+                break;
+            }
+            const auto id = c.id;
+            c.sequence.store(_head + _mask + 1, std::memory_order_release);
+            ++_head;
+            ++n;
+            fn(id);
+        }
+        return n;
+    }
+
+private:
+    struct cell {
+        std::atomic<std::size_t> sequence;
+        std::uint64_t id;
+    };
+
+    static std::size_t round_up(std::size_t n) {
+        std::size_t p = 1;
+        while (p < n) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    void signal() noexcept {
+        const std::uint64_t one = 1;
+        [[maybe_unused]] auto r = ::write(_write_fd, &one, _write_fd == _read_fd ? sizeof(one) : 1);
+    }
+
+    void clear() noexcept {
+        std::uint64_t buffer[8];
+        while (::read(_read_fd, buffer, sizeof(buffer)) > 0 && _write_fd != _read_fd) {}
+    }
+
+    std::atomic<std::uint32_t> _refs{1};
+    int _read_fd;
+    int _write_fd;
+    const std::size_t _mask;
+    std::unique_ptr<cell[]> _cells;
+    alignas(64) std::atomic<std::size_t> _tail{0};
+    alignas(64) std::size_t _head = 0;
+    std::atomic<bool> _signalled{false};
+    std::atomic<std::size_t> _outstanding{0};
+};
+
+// Callback a ready_queue installs on a watched future. It fits the in-place
+// buffer of the shared state, so watching allocates nothing.
+class ready_notifier {
+public:
+    ready_notifier(intrusive_ptr<ready_core> core, std::uint64_t id) : _core(std::move(core)), _id(id) {}
+    ready_notifier(ready_notifier&& o) noexcept = default;
+
+    // A future dropped without a value gives its place in the ring back.
+    ~ready_notifier() {
+        if (_core && !_fired) {
+            _core->retire(1);
+        }
+    }
+
+    template <typename V>
+    void operator()(V const&) {
+        _fired = true;
+        _core->push(_id);
+    }
+
+private:
+    intrusive_ptr<ready_core> _core;
+    std::uint64_t _id;
+    bool _fired = false;
+};
+
+} // namespace details
+
+// Readiness notification for event loops. Futures are watched under an id of
+// the caller's choosing; when one is fulfilled its id is queued and the
+// descriptor returned by fd() becomes readable. Register the descriptor with
+// epoll (EPOLLIN) and call reap() when it fires, then read the futures
+// themselves with try_get(). Fulfilments that arrive before the loop reaps
+// coalesce into a single wake-up, so any number of outstanding futures can
+// be served without blocking a thread on any of them.
+//
+// The descriptor is an eventfd on Linux and a pipe elsewhere. reap() must be
+// called from one thread at a time. The queue may be destroyed while watched
+// futures are still pending.
+class ready_queue {
+public:
+    // Up to `capacity`, rounded up to a power of two, watched futures may be
+    // outstanding, that is neither reaped nor dropped without a value.
+    explicit ready_queue(std::size_t capacity = 4096)
+        : _core(new details::ready_core(capacity))
+    {}
+
+    int fd() const noexcept {
+        return _core->fd();
+    }
+
+    std::size_t capacity() const noexcept {
+        return _core->capacity();
+    }
+
+    // Attaches to `f` the way on_ready() does, so `f` must not have a
+    // continuation yet. Returns false, attaching nothing, when `capacity`
+    // futures are already outstanding.
+    template <typename T, typename E>
+    bool watch(future<T, E>& f, std::uint64_t id) {
+        if (!_core->admit()) {
+            return false;
+        }
+        f.on_ready(details::ready_notifier(_core, id));
+        return true;
+    }
+
+    // Calls `fn(id)` for every future fulfilled since the last call and
+    // returns how many there were. Never blocks.
+    template <typename F>
+    std::size_t reap(F&& fn) {
+        const auto n = _core->drain(fn);
+        _core->retire(n);
+        return n;
+    }
+
+private:
+    details::intrusive_ptr<details::ready_core> _core;
+};
+
+}
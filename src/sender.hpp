@@ -0,0 +1,519 @@
+#pragma once
+
+#include "executor.hpp"
+#include "expected.hpp"
+#include "futex.hpp"
+#include "future.hpp"
+#include "optional.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// Lazy, allocation-free composition in the sender/receiver style.
+//
+// A sender describes work without starting it. connect() binds it to a
+// receiver, the object that is told the outcome, and returns an operation
+// state; start() on the operation state runs the work. Composing senders with
+// then(), on() and when_all() nests their operation states inside one
+// another, so a whole pipeline is a single object that lives wherever the
+// caller puts it - on the stack under sync_wait(), or in the one node
+// as_future() allocates to bridge it to a future.
+//
+// Receivers take the result as an expected through set_value(), the same way
+// shared states do. An operation must not touch itself after completing its
+// receiver, which may destroy it.
+//
+// Each composition has its own sender type; erasing it behind a single
+// task<T, E> would put the operation state on the heap again.
+namespace hntr::platform::lazy {
+
+template <typename S>
+concept sender = requires {
+    typename std::remove_cvref_t<S>::value_type;
+    typename std::remove_cvref_t<S>::error_type;
+    typename std::remove_cvref_t<S>::is_sender;
+};
+
+template <typename S, typename R>
+using operation_t = decltype(std::declval<S>().connect(std::declval<R>()));
+
+template <typename S>
+using result_t = expected<typename std::remove_cvref_t<S>::value_type, typename std::remove_cvref_t<S>::error_type>;
+
+template <typename Derived> class sender_base;
+
+namespace details {
+
+using platform::details::futex_wait;
+using platform::details::futex_wake_all;
+
+template <typename R, typename E>
+struct unwrap_expected {
+    using type = R;
+};
+
+template <typename T, typename E>
+struct unwrap_expected<expected<T, E>, E> {
+    using type = T;
+};
+
+template <typename F, typename T>
+struct stage_call {
+    using type = std::invoke_result_t<F&, T&&>;
+};
+
+template <typename F>
+struct stage_call<F, void> {
+    using type = std::invoke_result_t<F&>;
+};
+
+// Value type of a stage; a stage returning expected<R, E> has value type R.
+template <typename F, typename T, typename E>
+using stage_result_t = typename unwrap_expected<typename stage_call<F, T>::type, E>::type;
+
+// Calls `f` with the value of `input`, and `receiver` with what it returns.
+// Errors skip `f`. As with then() on futures, exceptions `f` throws are caught
+// only when E is std::exception_ptr; other chains fail by returning an
+// expected.
+template <typename O, typename I, typename E, typename F, typename R>
+void invoke_stage(F& f, expected<I, E>&& input, R& receiver) {
+    if (!input) {
+        receiver.set_value(expected<O, E>(unexpected(std::move(input).error())));
+        return;
+    }
+    auto call = [&]() {
+        using raw = typename stage_call<F, I>::type;
+        if constexpr (std::is_void_v<raw>) {
+            if constexpr (std::is_void_v<I>) {
+                f();
+            } else {
+                f(*std::move(input));
+            }
+            return expected<O, E>();
+        } else if constexpr (std::is_same_v<raw, expected<O, E>>) {
+            if constexpr (std::is_void_v<I>) {
+                return f();
+            } else {
+                return f(*std::move(input));
+            }
+        } else if constexpr (std::is_void_v<I>) {
+            return expected<O, E>(f());
+        } else {
+            return expected<O, E>(f(*std::move(input)));
+        }
+    };
+#if defined(__cpp_exceptions)
+    if constexpr (std::is_same_v<std::exception_ptr, E>) {
+        optional<expected<O, E>> result;
+        try {
+            result = call();
+        } catch (...) {
+            result = expected<O, E>(unexpected(std::current_exception()));
+        }
+        receiver.set_value(std::move(*result));
+        return;
+    }
+#endif
+    receiver.set_value(call());
+}
+
+} // namespace details
+
+template <typename T, typename E = std::exception_ptr>
+class just_sender;
+
+template <typename S, typename F>
+class then_sender;
+
+template <typename S>
+class on_sender;
+
+// then() and on() for every sender.
+template <typename Derived>
+class sender_base {
+public:
+    template <typename F>
+    then_sender<Derived, std::decay_t<F>> then(F&& handler) && {
+        return then_sender<Derived, std::decay_t<F>>(std::move(self()), std::forward<F>(handler));
+    }
+
+    // Starts the work it wraps as a task on `executor`.
+    on_sender<Derived> on(Executor& executor, schedule policy = schedule::post) && {
+        return on_sender<Derived>(std::move(self()), executor, policy);
+    }
+
+private:
+    Derived& self() {
+        return static_cast<Derived&>(*this);
+    }
+};
+
+template <typename T, typename E>
+class just_sender : public sender_base<just_sender<T, E>> {
+public:
+    using value_type = T;
+    using error_type = E;
+    using is_sender = void;
+
+    explicit just_sender(expected<T, E>&& value) : _value(std::move(value)) {}
+
+    template <typename R>
+    class operation {
+    public:
+        operation(expected<T, E>&& value, R&& receiver)
+            : _value(std::move(value))
+            , _receiver(std::move(receiver))
+        {}
+
+        operation(operation const&) = delete;
+
+        void start() noexcept {
+            _receiver.set_value(std::move(_value));
+        }
+
+    private:
+        expected<T, E> _value;
+        R _receiver;
+    };
+
+    template <typename R>
+    operation<R> connect(R receiver) && {
+        return operation<R>(std::move(_value), std::move(receiver));
+    }
+
+private:
+    expected<T, E> _value;
+};
+
+template <typename E = std::exception_ptr, typename T>
+just_sender<std::decay_t<T>, E> just(T&& value) {
+    return just_sender<std::decay_t<T>, E>(expected<std::decay_t<T>, E>(std::forward<T>(value)));
+}
+
+template <typename E = std::exception_ptr>
+just_sender<void, E> just() {
+    return just_sender<void, E>(expected<void, E>());
+}
+
+template <typename T, typename E>
+just_sender<T, E> just_error(E error) {
+    return just_sender<T, E>(expected<T, E>(unexpected<E>(std::move(error))));
+}
+
+template <typename S, typename F>
+class then_sender : public sender_base<then_sender<S, F>> {
+    using input_type = typename S::value_type;
+
+public:
+    using value_type = details::stage_result_t<F, input_type, typename S::error_type>;
+    using error_type = typename S::error_type;
+    using is_sender = void;
+
+    template <typename FF>
+    then_sender(S&& source, FF&& handler)
+        : _source(std::move(source))
+        , _handler(std::forward<FF>(handler))
+    {}
+
+    template <typename R>
+    class operation {
+        struct input_receiver {
+            operation* self;
+
+            void set_value(expected<input_type, error_type>&& value) {
+                details::invoke_stage<value_type>(self->_handler, std::move(value), self->_receiver);
+            }
+        };
+
+    public:
+        operation(S&& source, F&& handler, R&& receiver)
+            : _handler(std::move(handler))
+            , _receiver(std::move(receiver))
+            , _source(std::move(source).connect(input_receiver{this}))
+        {}
+
+        operation(operation const&) = delete;
+
+        void start() noexcept {
+            _source.start();
+        }
+
+    private:
+        F _handler;
+        R _receiver;
+        operation_t<S, input_receiver> _source;
+    };
+
+    template <typename R>
+    operation<R> connect(R receiver) && {
+        return operation<R>(std::move(_source), std::move(_handler), std::move(receiver));
+    }
+
+private:
+    S _source;
+    F _handler;
+};
+
+template <typename S>
+class on_sender : public sender_base<on_sender<S>> {
+public:
+    using value_type = typename S::value_type;
+    using error_type = typename S::error_type;
+    using is_sender = void;
+
+    on_sender(S&& source, Executor& executor, schedule policy)
+        : _source(std::move(source))
+        , _executor(executor)
+        , _policy(policy)
+    {}
+
+    // The operation is its own executor task, so scheduling it allocates
+    // nothing.
+    template <typename R>
+    class operation final : public task {
+    public:
+        operation(S&& source, Executor& executor, schedule policy, R&& receiver)
+            : _source(std::move(source).connect(std::move(receiver)))
+            , _executor(executor)
+            , _policy(policy)
+        {}
+
+        operation(operation const&) = delete;
+
+        void start() noexcept {
+            _executor.submit(*this, _policy);
+        }
+
+        void run() override {
+            _source.start();
+        }
+
+    private:
+        operation_t<S, R> _source;
+        Executor& _executor;
+        schedule _policy;
+    };
+
+    template <typename R>
+    operation<R> connect(R receiver) && {
+        return operation<R>(std::move(_source), _executor, _policy, std::move(receiver));
+    }
+
+private:
+    S _source;
+    Executor& _executor;
+    schedule _policy;
+};
+
+// Completes with every input's result once all of them have completed; the
+// inputs start in order and may complete on any thread.
+template <typename E, typename... Ss>
+class when_all_sender : public sender_base<when_all_sender<E, Ss...>> {
+public:
+    using value_type = std::tuple<result_t<Ss>...>;
+    using error_type = E;
+    using is_sender = void;
+
+    explicit when_all_sender(Ss&&... sources) : _sources(std::move(sources)...) {}
+
+    template <typename R>
+    class operation {
+        template <std::size_t I>
+        struct element_receiver {
+            operation* self;
+
+            void set_value(result_t<std::tuple_element_t<I, std::tuple<Ss...>>>&& value) {
+                std::get<I>(self->_results) = std::move(value);
+                self->arrive();
+            }
+        };
+
+        template <std::size_t I, typename S>
+        struct child {
+            child(S&& source, operation* self) : op(std::move(source).connect(element_receiver<I>{self})) {}
+
+            operation_t<S, element_receiver<I>> op;
+        };
+
+        template <typename Seq> struct children;
+
+        template <std::size_t... I>
+        struct children<std::index_sequence<I...>> : child<I, Ss>... {
+            children(std::tuple<Ss...>&& sources, operation* self)
+                : child<I, Ss>(std::move(std::get<I>(sources)), self)...
+            {}
+
+            void start() noexcept {
+                (child<I, Ss>::op.start(), ...);
+            }
+        };
+
+    public:
+        operation(std::tuple<Ss...>&& sources, R&& receiver)
+            : _receiver(std::move(receiver))
+            , _children(std::move(sources), this)
+        {}
+
+        operation(operation const&) = delete;
+
+        void start() noexcept {
+            _children.start();
+        }
+
+    private:
+        void arrive() {
+            if (_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                complete(std::index_sequence_for<Ss...>());
+            }
+        }
+
+        template <std::size_t... I>
+        void complete(std::index_sequence<I...>) {
+            _receiver.set_value(expected<value_type, E>(value_type(std::move(*std::get<I>(_results))...)));
+        }
+
+        R _receiver;
+        std::tuple<optional<result_t<Ss>>...> _results;
+        std::atomic<std::size_t> _pending{sizeof...(Ss)};
+        children<std::index_sequence_for<Ss...>> _children;
+    };
+
+    template <typename R>
+    operation<R> connect(R receiver) && {
+        return operation<R>(std::move(_sources), std::move(receiver));
+    }
+
+private:
+    std::tuple<Ss...> _sources;
+};
+
+template <sender S, sender... Ss>
+when_all_sender<typename S::error_type, S, Ss...> when_all(S&& first, Ss&&... rest) {
+    static_assert(!std::is_lvalue_reference_v<S> && (!std::is_lvalue_reference_v<Ss> && ...), "senders are consumed; pass them as rvalues");
+    static_assert((std::is_same_v<typename S::error_type, typename Ss::error_type> && ...), "inputs of when_all share an error type");
+    return when_all_sender<typename S::error_type, S, Ss...>(std::move(first), std::move(rest)...);
+}
+
+// Starts `work` and blocks until it completes. The operation state lives in
+// this frame.
+template <sender S>
+result_t<S> sync_wait(S&& work) {
+    struct state {
+        optional<result_t<S>> result;
+        std::atomic<std::uint32_t> done{0};
+    } st;
+
+    struct receiver {
+        state* st;
+
+        // The waiter may return, taking this receiver with it, as soon as
+        // `done` is set; only the address of the word is used after that.
+        void set_value(result_t<S>&& value) {
+            auto& done = st->done;
+            st->result = std::move(value);
+            done.store(1, std::memory_order_release);
+            details::futex_wake_all(done);
+        }
+    };
+
+    auto op = std::move(work).connect(receiver{&st});
+    op.start();
+    while (!st.done.load(std::memory_order_acquire)) {
+        details::futex_wait(st.done, 0);
+    }
+    return std::move(*st.result);
+}
+
+namespace details {
+
+// Shared state that also holds the operation feeding it.
+template <typename S>
+class sender_state final : public platform::details::precursor<typename S::value_type, typename S::error_type> {
+    using base = platform::details::precursor<typename S::value_type, typename S::error_type>;
+
+    struct receiver {
+        sender_state* self;
+
+        void set_value(result_t<S>&& value) {
+            self->set_value(std::move(value));
+            self->release();
+        }
+    };
+
+public:
+    explicit sender_state(S&& work) : _op(std::move(work).connect(receiver{this})) {}
+
+    void start() noexcept {
+        _op.start();
+    }
+
+private:
+    operation_t<S, receiver> _op;
+};
+
+} // namespace details
+
+// Starts `work` and returns a future for its result. This is the one place
+// a sender allocates: the shared state and the operation state share a node.
+template <sender S>
+future<typename S::value_type, typename S::error_type> as_future(S&& work) {
+    using T = typename S::value_type;
+    using E = typename S::error_type;
+    auto state = platform::details::make_intrusive<details::sender_state<std::remove_cvref_t<S>>>(std::move(work));
+    state->add_ref();
+    state->start();
+    return future<T, E>(platform::details::precursor_ptr<T, E>(std::move(state)));
+}
+
+// Sender that completes with the result of `input`. The callback it installs
+// on the future points back at the operation, so it is stored in place.
+template <typename T, typename E>
+class future_sender : public sender_base<future_sender<T, E>> {
+public:
+    using value_type = T;
+    using error_type = E;
+    using is_sender = void;
+
+    explicit future_sender(future<T, E>&& input) : _input(std::move(input)) {}
+
+    template <typename R>
+    class operation {
+    public:
+        operation(future<T, E>&& input, R&& receiver)
+            : _input(std::move(input))
+            , _receiver(std::move(receiver))
+        {}
+
+        operation(operation const&) = delete;
+
+        void start() noexcept {
+            std::move(_input).on_ready([this](auto&& result) {
+                _receiver.set_value(expected<T, E>(std::forward<decltype(result)>(result)));
+            });
+        }
+
+    private:
+        future<T, E> _input;
+        R _receiver;
+    };
+
+    template <typename R>
+    operation<R> connect(R receiver) && {
+        return operation<R>(std::move(_input), std::move(receiver));
+    }
+
+private:
+    future<T, E> _input;
+};
+
+template <typename T, typename E>
+future_sender<T, E> from_future(future<T, E> input) {
+    return future_sender<T, E>(std::move(input));
+}
+
+} // namespace hntr::platform::lazy
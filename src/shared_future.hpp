@@ -0,0 +1,243 @@
+#pragma once
+
+#include "future.hpp"
+
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace hntr::platform {
+
+namespace details {
+
+// Entry of the continuation stack of a shared state. It is embedded in the
+// consumer itself, so attaching one allocates nothing beyond the consumer.
+// notify() is called once, with the value, or with null if the state dies
+// without one.
+template <typename T, typename E>
+struct shared_listener {
+    using notify_fn = void (*)(shared_listener* self, expected<T, E> const* value);
+
+    explicit shared_listener(notify_fn notify = nullptr) : notify(notify) {}
+
+    shared_listener* next = nullptr;
+    notify_fn notify;
+};
+
+// State behind a shared_future. It is the single consumer of the future it
+// was made from and keeps the value it receives; any number of consumers
+// attach to it by pushing themselves onto a lock-free stack with a CAS. On
+// fulfilment the stack is swapped for a closed marker and drained once, in
+// attach order, and everyone attaching later finds the marker and runs
+// immediately. All consumers see the one stored value by const reference.
+template <typename T, typename E>
+class shared_state : public precursor<T, E> {
+public:
+    using value_type = expected<T, E>;
+    using listener = shared_listener<T, E>;
+
+    void handle(value_type const& value) {
+        this->set_value(value);
+        drain();
+        this->release();
+    }
+
+    void handle(value_type&& value) {
+        this->set_value(std::move(value));
+        drain();
+        this->release();
+    }
+
+    void discard() noexcept {
+        drain();
+        this->release();
+    }
+
+    void push(listener* l) {
+        auto* head = _listeners.load(std::memory_order_acquire);
+        do {
+            if (head == closed()) {
+                l->notify(l, stored());
+                return;
+            }
+            l->next = head;
+        } while (!_listeners.compare_exchange_weak(head, l, std::memory_order_acq_rel, std::memory_order_acquire));
+    }
+
+private:
+    void drain() noexcept {
+        auto* head = _listeners.exchange(closed(), std::memory_order_acq_rel);
+        listener* ordered = nullptr;
+        while (head) {
+            auto* next = head->next;
+            head->next = ordered;
+            ordered = head;
+            head = next;
+        }
+        auto const* value = stored();
+        while (ordered) {
+            auto* next = ordered->next;
+            ordered->notify(ordered, value);
+            ordered = next;
+        }
+    }
+
+    value_type const* stored() const noexcept {
+        return *this ? &this->get() : nullptr;
+    }
+
+    static listener* closed() noexcept {
+        static listener marker;
+        return &marker;
+    }
+
+    std::atomic<listener*> _listeners{nullptr};
+};
+
+// Makes a continuation object attachable to a shared state.
+template <typename Base, typename T, typename E>
+class listening : public Base, public shared_listener<T, E> {
+public:
+    template <typename... Args>
+    explicit listening(Args&&... args)
+        : Base(std::forward<Args>(args)...)
+        , shared_listener<T, E>(&notify)
+    {}
+
+private:
+    static void notify(shared_listener<T, E>* l, expected<T, E> const* value) {
+        auto* self = static_cast<listening*>(l);
+        if (value) {
+            self->handle(*value);
+        } else {
+            self->discard();
+        }
+    }
+};
+
+// Link run on an executor. Rather than copying the value into the task it
+// keeps the shared state alive and reads the value in place when it runs.
+template <typename Handler_t, typename T, typename O, typename E>
+class shared_scheduled_link
+    : public link<Handler_t, T, O, E>
+    , public task
+{
+public:
+    template <typename H>
+    shared_scheduled_link(H&& handler, Executor& executor, schedule policy, intrusive_ptr<shared_state<T, E>> state)
+        : link<Handler_t, T, O, E>(std::forward<H>(handler))
+        , _executor(executor)
+        , _policy(policy)
+        , _state(std::move(state))
+    {}
+
+    void handle(expected<T, E> const&) {
+        _executor.submit(*this, _policy);
+    }
+
+    void run() override {
+        link<Handler_t, T, O, E>::handle(std::as_const(*_state).get());
+    }
+
+private:
+    Executor& _executor;
+    schedule _policy;
+    intrusive_ptr<shared_state<T, E>> _state;
+};
+
+template <typename F, typename T, typename E>
+class callback_listener final : public shared_listener<T, E> {
+public:
+    template <typename FF>
+    explicit callback_listener(FF&& f)
+        : shared_listener<T, E>(&notify)
+        , _f(std::forward<FF>(f))
+    {}
+
+private:
+    static void notify(shared_listener<T, E>* l, expected<T, E> const* value) {
+        std::unique_ptr<callback_listener> self(static_cast<callback_listener*>(l));
+        if (value) {
+            self->_f(*value);
+        }
+    }
+
+    F _f;
+};
+
+} // namespace details
+
+// Future whose result any number of consumers can read and continue from, for
+// broadcasting one result - a config reload, a cache fill - to all of them.
+// Copies share the state. Every continuation receives a const reference to the
+// one stored value; continuations attached before the value arrives run in
+// the order they were attached, on the thread that fulfils it.
+template <typename T, typename E = std::exception_ptr>
+class shared_future {
+public:
+    using value_type = expected<T, E>;
+
+    explicit shared_future() {}
+
+    // Takes over `source`; its value is moved into the shared state.
+    explicit shared_future(future<T, E> source) {
+        auto& upstream = details::future_access::state(source);
+        _state = details::allocate_intrusive<details::shared_state<T, E>>(upstream->resource());
+        _state->add_ref();
+        upstream->set_continuation(_state.get(), true);
+    }
+
+    template <typename TT = T, typename = typename std::enable_if_t<!std::is_void_v<TT>>>
+    TT const& get() const {
+        return *std::as_const(*_state).get();
+    }
+
+    template <typename TT = T>
+    typename std::enable_if_t<std::is_void_v<TT>, void>
+    get() const {
+        *std::as_const(*_state).get();
+    }
+
+    value_type const& result() const {
+        return std::as_const(*_state).get();
+    }
+
+    bool is_ready() const noexcept {
+        return _state && !!*_state;
+    }
+
+    value_type const* try_get() const noexcept {
+        return _state ? _state->try_get() : nullptr;
+    }
+
+    template<typename F, typename R = typename details::resolver<F, T, E>::return_type>
+    future<R, E> then(F&& handler) const {
+        using node = details::listening<details::link<std::decay_t<F>, T, R, E>, T, E>;
+        auto cont = details::allocate_intrusive<node>(_state->resource(), std::forward<F>(handler));
+        cont->add_ref();
+        _state->push(cont.get());
+        return future<R, E>(std::move(cont));
+    }
+
+    template<typename F, typename R = typename details::resolver<F, T, E>::return_type>
+    future<R, E> then(Executor& executor, F&& handler, schedule policy = schedule::post) const {
+        using node = details::listening<details::shared_scheduled_link<std::decay_t<F>, T, R, E>, T, E>;
+        auto cont = details::allocate_intrusive<node>(_state->resource(), std::forward<F>(handler), executor, policy, _state);
+        cont->add_ref();
+        _state->push(cont.get());
+        return future<R, E>(std::move(cont));
+    }
+
+    // Calls `handler` with a const reference to the result. Unlike
+    // future::on_ready() the handler is allocated, as any number may wait.
+    template <typename F>
+    void on_ready(F&& handler) const {
+        _state->push(new details::callback_listener<std::decay_t<F>, T, E>(std::forward<F>(handler)));
+    }
+
+private:
+    details::intrusive_ptr<details::shared_state<T, E>> _state;
+};
+
+}
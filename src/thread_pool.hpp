@@ -0,0 +1,381 @@
+#pragma once
+
+#include "executor.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace hntr::platform {
+
+namespace details {
+
+// Chase-Lev work-stealing deque, following Lê et al., "Correct and Efficient
+// Work-Stealing for Weak Memory Models". The owning worker pushes and pops at
+// the bottom, thieves steal from the top. Slots are accessed with
+// release/acquire so the task contents are published with the slot.
+class work_stealing_deque {
+public:
+    explicit work_stealing_deque(std::size_t capacity = 256)
+        : _ring(new ring(capacity))
+    {
+        _rings.emplace_back(_ring.load(std::memory_order_relaxed));
+    }
+
+    work_stealing_deque(work_stealing_deque const&) = delete;
+    work_stealing_deque& operator= (work_stealing_deque const&) = delete;
+
+    // Owner only.
+    void push(task* t) {
+        auto b = _bottom.load(std::memory_order_relaxed);
+        auto top = _top.load(std::memory_order_acquire);
+        auto* r = _ring.load(std::memory_order_relaxed);
+        if (b - top > r->capacity - 1) {
+            r = grow(r, top, b);
+        }
+        r->put(b, t);
+        std::atomic_thread_fence(std::memory_order_release);
+        _bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // Owner only.
+    task* pop() {
+        auto b = _bottom.load(std::memory_order_relaxed) - 1;
+        auto* r = _ring.load(std::memory_order_relaxed);
+        _bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto top = _top.load(std::memory_order_relaxed);
+
+        if (top > b) {
+            _bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        auto* t = r->get(b);
+        if (top == b) {
+            // Last element: race the thieves for it.
+            if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                t = nullptr;
+            }
+            _bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return t;
+    }
+
+    // Any thread.
+    task* steal() {
+        auto top = _top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto b = _bottom.load(std::memory_order_acquire);
+        if (top >= b) {
+            return nullptr;
+        }
+
+        auto* t = _ring.load(std::memory_order_acquire)->get(top);
+        if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return t;
+    }
+
+    bool empty() const {
+        auto b = _bottom.load(std::memory_order_acquire);
+        auto top = _top.load(std::memory_order_acquire);
+        return top >= b;
+    }
+
+private:
+    struct ring {
+        explicit ring(std::size_t cap)
+            : capacity(static_cast<std::int64_t>(cap))
+            , mask(capacity - 1)
+            , slots(new std::atomic<task*>[cap])
+        {}
+
+        task* get(std::int64_t i) const {
+            return slots[i & mask].load(std::memory_order_acquire);
+        }
+
+        void put(std::int64_t i, task* t) {
+            slots[i & mask].store(t, std::memory_order_release);
+        }
+
+        std::int64_t capacity;
+        std::int64_t mask;
+        std::unique_ptr<std::atomic<task*>[]> slots;
+    };
+
+    // Thieves may still be reading the old ring, so it is retired rather than
+    // freed; all rings live until the deque is destroyed.
+    ring* grow(ring* old, std::int64_t top, std::int64_t bottom) {
+        auto* r = new ring(static_cast<std::size_t>(old->capacity) * 2);
+        for (auto i = top; i < bottom; ++i) {
+            r->put(i, old->get(i));
+        }
+        _rings.emplace_back(r);
+        _ring.store(r, std::memory_order_release);
+        return r;
+    }
+
+    alignas(64) std::atomic<std::int64_t> _top{0};
+    alignas(64) std::atomic<std::int64_t> _bottom{0};
+    std::atomic<ring*> _ring;
+    std::vector<std::unique_ptr<ring>> _rings;
+};
+
+} // namespace details
+
+// Work-stealing pool.
+//
+// Each worker owns a Chase-Lev deque and a single LIFO slot. Work submitted
+// from outside the pool goes through a shared injection queue; work submitted
+// from a worker stays on that worker: post() pushes to its deque and defer()
+// puts the task into the LIFO slot so the continuation it just produced runs
+// next, while its data is still in cache. Idle workers steal from the top of
+// other deques, then from LIFO slots, so a continuation is not stranded behind
+// a long task of its worker, and park when there is nothing left.
+class thread_pool final : public Executor {
+public:
+    explicit thread_pool(std::size_t threads = std::max(1u, std::thread::hardware_concurrency())) {
+        _workers.reserve(threads);
+        for (std::size_t i = 0; i < threads; ++i) {
+            _workers.emplace_back(std::make_unique<worker>());
+        }
+        for (std::size_t i = 0; i < threads; ++i) {
+            _workers[i]->thread = std::thread([this, i]() { run(i); });
+        }
+    }
+
+    thread_pool(thread_pool const&) = delete;
+    thread_pool& operator= (thread_pool const&) = delete;
+
+    // Runs everything already submitted, then joins the workers.
+    ~thread_pool() {
+        {
+            std::lock_guard lock(_park_mutex);
+            _stopping.store(true, std::memory_order_release);
+        }
+        _park_cond.notify_all();
+        for (auto& w : _workers) {
+            w->thread.join();
+        }
+    }
+
+    void post(task& t) override {
+        if (auto* w = local_worker()) {
+            w->deque.push(&t);
+        } else {
+            inject(t);
+        }
+        notify();
+    }
+
+    void defer(task& t) override {
+        auto* w = local_worker();
+        if (!w) {
+            inject(t);
+            notify();
+            return;
+        }
+        if (auto* displaced = w->lifo.exchange(&t, std::memory_order_acq_rel)) {
+            w->deque.push(displaced);
+        }
+        notify();
+    }
+
+    bool running_in_this_thread() const override {
+        return _current_pool == this;
+    }
+
+    std::size_t size() const {
+        return _workers.size();
+    }
+
+private:
+    struct worker {
+        details::work_stealing_deque deque;
+        std::atomic<task*> lifo{nullptr};
+        std::thread thread;
+    };
+
+    worker* local_worker() const {
+        return _current_pool == this ? _current_worker : nullptr;
+    }
+
+    void inject(task& t) {
+        std::lock_guard lock(_inject_mutex);
+        t.next = nullptr;
+        if (_inject_tail) {
+            _inject_tail->next = &t;
+        } else {
+            _inject_head = &t;
+        }
+        _inject_tail = &t;
+        _injected.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    task* take_injected() {
+        if (_injected.load(std::memory_order_relaxed) == 0) {
+            return nullptr;
+        }
+        std::lock_guard lock(_inject_mutex);
+        auto* t = _inject_head;
+        if (t) {
+            _inject_head = t->next;
+            if (!_inject_head) {
+                _inject_tail = nullptr;
+            }
+            _injected.fetch_sub(1, std::memory_order_relaxed);
+        }
+        return t;
+    }
+
+    // Deques first: a LIFO slot is the continuation its worker runs next, and
+    // is only taken when there is nothing older to take.
+    task* steal(std::size_t self) {
+        const auto n = _workers.size();
+        const auto start = next_random() % n;
+        for (std::size_t i = 0; i < n; ++i) {
+            const auto victim = (start + i) % n;
+            if (victim == self) {
+                continue;
+            }
+            if (auto* t = _workers[victim]->deque.steal()) {
+                return t;
+            }
+        }
+        for (std::size_t i = 0; i < n; ++i) {
+            const auto victim = (start + i) % n;
+            if (victim == self) {
+                continue;
+            }
+            auto& lifo = _workers[victim]->lifo;
+            if (lifo.load(std::memory_order_relaxed)) {
+                if (auto* t = lifo.exchange(nullptr, std::memory_order_acq_rel)) {
+                    return t;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    task* find_work(std::size_t self) {
+        auto& w = *_workers[self];
+        if (auto* t = w.lifo.exchange(nullptr, std::memory_order_acq_rel)) {
+            return t;
+        }
+        if (auto* t = w.deque.pop()) {
+            return t;
+        }
+        if (auto* t = take_injected()) {
+            return t;
+        }
+        return steal(self);
+    }
+
+    bool has_work() const {
+        if (_injected.load(std::memory_order_seq_cst) != 0) {
+            return true;
+        }
+        for (auto& w : _workers) {
+            if (!w->deque.empty() || w->lifo.load(std::memory_order_seq_cst)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(std::size_t self) {
+        executor_scope scope(*this);
+        _current_pool = this;
+        _current_worker = _workers[self].get();
+
+        while (true) {
+            if (auto* t = find_work(self)) {
+                t->run();
+                continue;
+            }
+            if (!park()) {
+                break;
+            }
+        }
+
+        _current_worker = nullptr;
+        _current_pool = nullptr;
+    }
+
+    // Returns false once the pool is stopping and no work is left. A worker
+    // announces itself as sleeping before re-checking the queues and a
+    // submitter publishes its work before checking for sleepers, so one of the
+    // two always sees the other.
+    //
+    // There are never more wake-ups pending than sleepers: notify() adds none
+    // beyond that, and a sleeper takes one whichever way it leaves, so a
+    // burst of submissions cannot leave later park() calls returning at once.
+    bool park() {
+        std::unique_lock lock(_park_mutex);
+        _sleepers.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool running = true;
+        while (!has_work() && _wakeups == 0) {
+            if (_stopping.load(std::memory_order_acquire)) {
+                running = false;
+                break;
+            }
+            _park_cond.wait(lock);
+        }
+        if (_wakeups > 0) {
+            --_wakeups;
+        }
+        _sleepers.fetch_sub(1, std::memory_order_relaxed);
+        return running;
+    }
+
+    void notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_sleepers.load(std::memory_order_seq_cst) == 0) {
+            return;
+        }
+        {
+            std::lock_guard lock(_park_mutex);
+            if (_wakeups >= _sleepers.load(std::memory_order_relaxed)) {
+                return;
+            }
+            ++_wakeups;
+        }
+        _park_cond.notify_one();
+    }
+
+    static std::uint32_t next_random() {
+        static thread_local std::uint32_t state = 0x9e3779b9u ^ static_cast<std::uint32_t>(
+                std::hash<std::thread::id>()(std::this_thread::get_id()));
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    std::vector<std::unique_ptr<worker>> _workers;
+
+    std::mutex _inject_mutex;
+    task* _inject_head = nullptr;
+    task* _inject_tail = nullptr;
+    std::atomic<std::size_t> _injected{0};
+
+    std::mutex _park_mutex;
+    std::condition_variable _park_cond;
+    std::atomic<std::size_t> _sleepers{0};
+    std::size_t _wakeups = 0;
+    std::atomic<bool> _stopping{false};
+
+    static inline thread_local thread_pool const* _current_pool = nullptr;
+    static inline thread_local worker* _current_worker = nullptr;
+};
+
+}
@@ -0,0 +1,448 @@
+#pragma once
+
+#include "expected_array.hpp"
+#include "future.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace hntr::platform {
+
+// Result of when_any() and element of when_n(): which input completed and
+// what it completed with.
+template <typename T, typename E>
+struct when_any_result {
+    std::size_t index;
+    expected<T, E> value;
+};
+
+namespace details {
+
+// One input of a join: the continuation attached to that input, which hands
+// the value it receives straight to the join. The elements of a range join
+// are allocated as one array when the join is created, so joining N futures
+// costs no allocation per future. Each element holds a reference on the join
+// until its value has been handed over or its input has been dropped without
+// one.
+template <typename Join, typename T, typename E>
+class join_element final {
+public:
+    void bind(Join* join, std::size_t index) {
+        _join = join;
+        _index = index;
+    }
+
+    void handle(expected<T, E> const& value) {
+        auto* join = _join;
+        join->arrive(_index, value);
+        join->release();
+    }
+
+    void handle(expected<T, E> && value) {
+        auto* join = _join;
+        join->arrive(_index, std::move(value));
+        join->release();
+    }
+
+    void discard() noexcept {
+        _join->release();
+    }
+
+private:
+    Join* _join = nullptr;
+    std::size_t _index = 0;
+};
+
+template <typename F> struct future_traits {};
+template <typename T, typename E> struct future_traits<future<T, E>> {
+    using value_type = T;
+    using error_type = E;
+};
+
+template <typename Range>
+using range_future_t = std::decay_t<decltype(*std::begin(std::declval<Range&>()))>;
+
+// A join given the inputs themselves, rather than references to futures the
+// caller keeps, `consumes` them: an input already fulfilled and referenced by
+// nothing else is moved into the result instead of copied.
+template <typename Join, typename Element, typename T, typename E>
+void join_attach(Join* join, Element& element, std::size_t index, future<T, E> const& input, bool consume) {
+    element.bind(join, index);
+    join->add_ref();
+    future_access::state(input)->set_continuation(&element, consume);
+}
+
+// Where E is default constructible, a join builds its result when it is
+// created, with a value-initialised error standing in for each input that has
+// not arrived yet. Each arrival is then assigned to its own slot, and the last
+// one publishes the result as it is. For any other E each slot is constructed
+// only when its input arrives, and the result is assembled from the slots on
+// completion.
+template <typename E>
+inline constexpr bool join_in_place = std::is_default_constructible_v<E>;
+
+template <typename T, typename E>
+expected<T, E> join_placeholder(std::type_identity<expected<T, E>>) {
+    return expected<T, E>(unexpected<E>(E()));
+}
+
+template <typename T, typename E>
+when_any_result<T, E> join_placeholder(std::type_identity<when_any_result<T, E>>) {
+    return when_any_result<T, E>{0, join_placeholder(std::type_identity<expected<T, E>>())};
+}
+
+// The slots of a range join's result, R being one element of it.
+template <typename R, typename E, bool = join_in_place<E>>
+class join_slots {
+public:
+    explicit join_slots(std::size_t size) {
+        _result.reserve(size);
+        for (std::size_t i = 0; i < size; ++i) {
+            _result.push_back(join_placeholder(std::type_identity<R>()));
+        }
+    }
+
+    template <typename V>
+    void store(std::size_t index, V&& value) {
+        _result[index] = std::forward<V>(value);
+    }
+
+    std::vector<R> take() {
+        return std::move(_result);
+    }
+
+private:
+    std::vector<R> _result;
+};
+
+template <typename R, typename E>
+class join_slots<R, E, false> {
+public:
+    explicit join_slots(std::size_t size)
+        : _slots(new optional<R>[size])
+        , _size(size)
+    {}
+
+    template <typename V>
+    void store(std::size_t index, V&& value) {
+        _slots[index] = std::forward<V>(value);
+    }
+
+    std::vector<R> take() {
+        std::vector<R> result;
+        result.reserve(_size);
+        for (std::size_t i = 0; i < _size; ++i) {
+            result.push_back(*std::move(_slots[i]));
+        }
+        return result;
+    }
+
+private:
+    std::unique_ptr<optional<R>[]> _slots;
+    std::size_t _size;
+};
+
+// Joins a fixed set of futures of possibly different types. Each input writes
+// its own member of the result tuple; the last to arrive, as counted down by
+// `_pending`, publishes it.
+template <typename E, typename... Ts>
+class when_all_tuple final : public precursor<std::tuple<expected<Ts, E>...>, E> {
+public:
+    using result_type = std::tuple<expected<Ts, E>...>;
+
+    when_all_tuple()
+        : _result(empty_result())
+        , _pending(sizeof...(Ts))
+    {}
+
+    void attach(bool consume, future<Ts, E> const&... inputs) {
+        attach(std::index_sequence_for<Ts...>(), consume, inputs...);
+    }
+
+    template <typename V>
+    void arrive(std::size_t index, V&& value) {
+        store(index, std::forward<V>(value), std::index_sequence_for<Ts...>());
+        if (_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            this->set_value(expected<result_type, E>(take(std::index_sequence_for<Ts...>())));
+        }
+    }
+
+private:
+    using slots_type = std::conditional_t<join_in_place<E>, result_type, std::tuple<optional<expected<Ts, E>>...>>;
+
+    static slots_type empty_result() {
+        if constexpr (join_in_place<E>) {
+            return slots_type(join_placeholder(std::type_identity<expected<Ts, E>>())...);
+        } else {
+            return slots_type();
+        }
+    }
+
+    template <std::size_t... I>
+    result_type take(std::index_sequence<I...>) {
+        if constexpr (join_in_place<E>) {
+            return std::move(_result);
+        } else {
+            return result_type(*std::move(std::get<I>(_result))...);
+        }
+    }
+
+    template <std::size_t... I>
+    void attach(std::index_sequence<I...>, bool consume, future<Ts, E> const&... inputs) {
+        (join_attach(this, std::get<I>(_elements), I, inputs, consume), ...);
+    }
+
+    // Several members may have the type of `value`; the index picks one.
+    template <typename V, std::size_t... I>
+    void store(std::size_t index, V&& value, std::index_sequence<I...>) {
+        ([&]() {
+            if constexpr (std::is_same_v<std::remove_cvref_t<V>, std::tuple_element_t<I, result_type>>) {
+                if (index == I) {
+                    std::get<I>(_result) = std::forward<V>(value);
+                }
+            }
+        }(), ...);
+    }
+
+    std::tuple<join_element<when_all_tuple, Ts, E>...> _elements;
+    slots_type _result;
+    std::atomic<std::size_t> _pending;
+};
+
+// Joins a range of futures of one type; results keep the order of the range.
+// Each input writes its own slot of the result, which is allocated with the
+// join, and the last one to arrive publishes it.
+template <typename T, typename E>
+class when_all_range final : public precursor<std::vector<expected<T, E>>, E> {
+public:
+    using result_type = std::vector<expected<T, E>>;
+    using element_type = join_element<when_all_range, T, E>;
+
+    explicit when_all_range(std::size_t size)
+        : _elements(new element_type[size])
+        , _result(size)
+        , _pending(size)
+    {}
+
+    element_type& operator[] (std::size_t index) {
+        return _elements[index];
+    }
+
+    template <typename V>
+    void arrive(std::size_t index, V&& value) {
+        _result.store(index, std::forward<V>(value));
+        if (_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            this->set_value(expected<result_type, E>(_result.take()));
+        }
+    }
+
+private:
+    std::unique_ptr<element_type[]> _elements;
+    join_slots<expected<T, E>, E> _result;
+    std::atomic<std::size_t> _pending;
+};
+
+// Joins a range of futures of one type straight into columns: each input
+// writes its value or error into its own slot of the result as it arrives,
+// and the last one to arrive publishes it.
+template <typename T, typename E>
+class when_all_columns final : public precursor<expected_array<T, E>, E> {
+public:
+    using element_type = join_element<when_all_columns, T, E>;
+
+    explicit when_all_columns(std::size_t size)
+        : _elements(new element_type[size])
+        , _result(size)
+        , _pending(size)
+    {}
+
+    element_type& operator[] (std::size_t index) {
+        return _elements[index];
+    }
+
+    template <typename V>
+    void arrive(std::size_t index, V&& value) {
+        _result.set(index, std::forward<V>(value));
+        if (_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            this->set_value(expected<expected_array<T, E>, E>(std::move(_result)));
+        }
+    }
+
+private:
+    std::unique_ptr<element_type[]> _elements;
+    expected_array<T, E> _result;
+    std::atomic<std::size_t> _pending;
+};
+
+// Completes with the first `count` inputs to arrive, in the order they
+// arrived. Both phases of an arrival go through the one counter: the low half
+// hands out positions in the result, the high half counts the positions that
+// have been filled in, and whoever fills the last one publishes. Inputs that
+// arrive after the first `count` are dropped.
+template <typename T, typename E>
+class when_n_range final : public precursor<std::vector<when_any_result<T, E>>, E> {
+public:
+    using result_type = std::vector<when_any_result<T, E>>;
+    using element_type = join_element<when_n_range, T, E>;
+
+    when_n_range(std::size_t size, std::size_t count)
+        : _elements(new element_type[size])
+        , _result(count)
+        , _count(count)
+    {}
+
+    element_type& operator[] (std::size_t index) {
+        return _elements[index];
+    }
+
+    template <typename V>
+    void arrive(std::size_t index, V&& value) {
+        constexpr std::uint64_t filled = std::uint64_t(1) << 32;
+
+        auto position = _counter.fetch_add(1, std::memory_order_acq_rel) & (filled - 1);
+        if (position >= _count) {
+            return;
+        }
+        _result.store(position, when_any_result<T, E>{index, expected<T, E>(std::forward<V>(value))});
+        if ((_counter.fetch_add(filled, std::memory_order_acq_rel) >> 32) == _count - 1) {
+            this->set_value(expected<result_type, E>(_result.take()));
+        }
+    }
+
+private:
+    std::unique_ptr<element_type[]> _elements;
+    join_slots<when_any_result<T, E>, E> _result;
+    std::size_t _count;
+    std::atomic<std::uint64_t> _counter{0};
+};
+
+// Completes with whichever input arrives first; the first increment of the
+// counter wins and later arrivals are dropped.
+template <typename T, typename E>
+class when_any_range final : public precursor<when_any_result<T, E>, E> {
+public:
+    using element_type = join_element<when_any_range, T, E>;
+
+    explicit when_any_range(std::size_t size) : _elements(new element_type[size]) {}
+
+    element_type& operator[] (std::size_t index) {
+        return _elements[index];
+    }
+
+    template <typename V>
+    void arrive(std::size_t index, V&& value) {
+        if (_arrived.fetch_add(1, std::memory_order_acq_rel) == 0) {
+            this->set_value(expected<when_any_result<T, E>, E>(
+                    when_any_result<T, E>{index, expected<T, E>(std::forward<V>(value))}));
+        }
+    }
+
+private:
+    std::unique_ptr<element_type[]> _elements;
+    std::atomic<std::size_t> _arrived{0};
+};
+
+template <typename Join, typename Range>
+void join_attach_range(Join* join, Range& inputs, bool consume) {
+    std::size_t index = 0;
+    for (auto& input : inputs) {
+        join_attach(join, (*join)[index], index, input, consume);
+        ++index;
+    }
+}
+
+} // namespace details
+
+// Joins take over the continuation slot of each input: the inputs must not
+// have a continuation yet and must not be given one afterwards. Errors are
+// reported per input, in the input's own expected; the joined future itself
+// never fails. The result is allocated with the join and each input writes
+// its own slot as it arrives. Like then() on an rvalue, a join given rvalue
+// futures, or an rvalue range of them, moves their values into the result
+// once nothing else refers to them; otherwise the values are copied.
+
+template <typename E, typename... Ts>
+future<std::tuple<expected<Ts, E>...>, E> when_all(future<Ts, E> const&... inputs) {
+    auto join = details::make_intrusive<details::when_all_tuple<E, Ts...>>();
+    join->attach(false, inputs...);
+    return future<std::tuple<expected<Ts, E>...>, E>(std::move(join));
+}
+
+template <typename E, typename... Ts>
+future<std::tuple<expected<Ts, E>...>, E> when_all(future<Ts, E>&&... inputs) {
+    auto join = details::make_intrusive<details::when_all_tuple<E, Ts...>>();
+    join->attach(true, inputs...);
+    return future<std::tuple<expected<Ts, E>...>, E>(std::move(join));
+}
+
+template <typename Range,
+          typename F = details::range_future_t<Range>,
+          typename T = typename details::future_traits<F>::value_type,
+          typename E = typename details::future_traits<F>::error_type>
+future<std::vector<expected<T, E>>, E> when_all(Range&& inputs) {
+    const auto size = static_cast<std::size_t>(std::distance(std::begin(inputs), std::end(inputs)));
+    auto join = details::make_intrusive<details::when_all_range<T, E>>(size);
+    if (size == 0) {
+        join->set_value(expected<std::vector<expected<T, E>>, E>(std::vector<expected<T, E>>()));
+    } else {
+        details::join_attach_range(join.get(), inputs, !std::is_lvalue_reference_v<Range>);
+    }
+    return future<std::vector<expected<T, E>>, E>(std::move(join));
+}
+
+// As when_all() over a range, but the results arrive in an expected_array
+// rather than a vector of expected.
+template <typename Range,
+          typename F = details::range_future_t<Range>,
+          typename T = typename details::future_traits<F>::value_type,
+          typename E = typename details::future_traits<F>::error_type>
+future<expected_array<T, E>, E> when_all_columns(Range&& inputs) {
+    const auto size = static_cast<std::size_t>(std::distance(std::begin(inputs), std::end(inputs)));
+    auto join = details::make_intrusive<details::when_all_columns<T, E>>(size);
+    if (size == 0) {
+        join->set_value(expected<expected_array<T, E>, E>(expected_array<T, E>()));
+    } else {
+        details::join_attach_range(join.get(), inputs, !std::is_lvalue_reference_v<Range>);
+    }
+    return future<expected_array<T, E>, E>(std::move(join));
+}
+
+// The range must not be empty.
+template <typename Range,
+          typename F = details::range_future_t<Range>,
+          typename T = typename details::future_traits<F>::value_type,
+          typename E = typename details::future_traits<F>::error_type>
+future<when_any_result<T, E>, E> when_any(Range&& inputs) {
+    const auto size = static_cast<std::size_t>(std::distance(std::begin(inputs), std::end(inputs)));
+    assert(size > 0);
+    auto join = details::make_intrusive<details::when_any_range<T, E>>(size);
+    details::join_attach_range(join.get(), inputs, !std::is_lvalue_reference_v<Range>);
+    return future<when_any_result<T, E>, E>(std::move(join));
+}
+
+// Completes once `count` inputs have arrived; `count` must not exceed the size
+// of the range.
+template <typename Range,
+          typename F = details::range_future_t<Range>,
+          typename T = typename details::future_traits<F>::value_type,
+          typename E = typename details::future_traits<F>::error_type>
+future<std::vector<when_any_result<T, E>>, E> when_n(std::size_t count, Range&& inputs) {
+    const auto size = static_cast<std::size_t>(std::distance(std::begin(inputs), std::end(inputs)));
+    assert(count <= size);
+    auto join = details::make_intrusive<details::when_n_range<T, E>>(size, count);
+    if (count == 0) {
+        join->set_value(expected<std::vector<when_any_result<T, E>>, E>(std::vector<when_any_result<T, E>>()));
+    }
+    details::join_attach_range(join.get(), inputs, !std::is_lvalue_reference_v<Range>);
+    return future<std::vector<when_any_result<T, E>>, E>(std::move(join));
+}
+
+}
@@ -0,0 +1,274 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+#include "batch_future.hpp"
+#include "future.hpp"
+#include "ready_queue.hpp"
+#include "sender.hpp"
+#include "when_all.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <memory_resource>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace hntr::platform;
+
+namespace {
+
+std::atomic<std::size_t> allocations{0};
+
+struct allocation_counter {
+    allocation_counter() : _start(allocations.load()) {}
+    std::size_t count() const { return allocations.load() - _start; }
+
+private:
+    std::size_t _start;
+};
+
+// Forwards to the default resource and counts what is outstanding.
+class counting_resource : public std::pmr::memory_resource {
+public:
+    std::size_t allocated = 0;
+    std::size_t outstanding = 0;
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+        ++allocated;
+        ++outstanding;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+        --outstanding;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+} // namespace
+
+// GCC pairs the inlined free() below with the new-expressions it was called
+// from and reports a mismatch; the replacement operators are consistent.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (auto p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+TEST_CASE("Promise allocates its shared state once", "[allocation]") {
+    allocation_counter counter;
+    promise<int> p;
+    auto f = p.get_future();
+    p.set_value(1);
+    REQUIRE(f.get() == 1);
+    REQUIRE(counter.count() == 1);
+}
+
+TEST_CASE("Each chained hop costs a single allocation", "[allocation]") {
+    promise<int> p;
+    auto f = p.get_future();
+
+    allocation_counter counter;
+    auto result = f.then([](int v) { return v + 1; })
+            .then([](int v) { return v + 1; })
+            .then([](int v) { return v + 1; })
+            .then([](int v) { return v + 1; })
+            .then([](int v) { return v + 1; });
+    p.set_value(1);
+
+    REQUIRE(result.get() == 6);
+    REQUIRE(counter.count() == 5);
+}
+
+TEST_CASE("A pipeline costs a single allocation", "[allocation][pipe]") {
+    promise<int> p;
+    auto f = p.get_future();
+
+    allocation_counter counter;
+    future<int, std::exception_ptr> result = f.pipe()
+            .then([](int v) { return v + 1; })
+            .then([](int v) { return v + 1; })
+            .then([](int v) { return v + 1; })
+            .then([](int v) { return v + 1; })
+            .then([](int v) { return v + 1; });
+    p.set_value(1);
+
+    REQUIRE(result.get() == 6);
+    REQUIRE(counter.count() == 1);
+}
+
+TEST_CASE("Hop attached to a fulfilled future costs a single allocation", "[allocation]") {
+    promise<int> p;
+    p.set_value(1);
+    auto f = p.get_future();
+
+    allocation_counter counter;
+    auto result = f.then([](int v) { return v * 2; });
+
+    REQUIRE(result.get() == 2);
+    REQUIRE(counter.count() == 1);
+}
+
+TEST_CASE("Joining futures costs no allocation per input", "[allocation]") {
+    std::vector<promise<int>> promises(64);
+    std::vector<future<int, std::exception_ptr>> futures;
+    for (auto& p : promises) {
+        futures.push_back(p.get_future());
+    }
+
+    allocation_counter counter;
+    auto all = when_all(futures);
+    // Join state, element block and the result vector, all up front.
+    REQUIRE(counter.count() == 3);
+    for (auto& p : promises) {
+        p.set_value(1);
+    }
+    REQUIRE(all.get().size() == 64);
+    REQUIRE(counter.count() == 3);
+}
+
+TEST_CASE("Joining a fixed set of futures costs a single allocation", "[allocation]") {
+    promise<int> a;
+    promise<int> b;
+    auto fa = a.get_future();
+    auto fb = b.get_future();
+
+    allocation_counter counter;
+    auto both = when_all(fa, fb);
+    a.set_value(1);
+    b.set_value(2);
+    REQUIRE(*std::get<1>(both.get()) == 2);
+    REQUIRE(counter.count() == 1);
+}
+
+TEST_CASE("Links are allocated from the promise's memory resource", "[allocation][pmr]") {
+    counting_resource resource;
+    {
+        promise<int> p(std::allocator_arg, &resource);
+        auto result = p.get_future()
+                .then([](int v) { return v + 1; })
+                .then([](int v) { return std::to_string(v); })
+                .then([](std::string const& v) { return v.size(); });
+        p.set_value(41);
+        REQUIRE(result.get() == 2);
+        REQUIRE(resource.allocated == 4);
+    }
+    REQUIRE(resource.outstanding == 0);
+}
+
+TEST_CASE("A chain in a monotonic arena does not touch the heap", "[allocation][pmr]") {
+    char buffer[4096];
+    std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+
+    allocation_counter counter;
+    promise<int> p(std::allocator_arg, &arena);
+    auto result = p.get_future()
+            .then([](int v) { return v + 1; })
+            .then([](int v) { return v * 2; });
+    p.set_value(1);
+    REQUIRE(result.get() == 4);
+    REQUIRE(counter.count() == 0);
+}
+
+TEST_CASE("on_ready with a small capture does not allocate", "[allocation]") {
+    promise<int> p;
+    auto f = p.get_future();
+    int a = 0, b = 0, c = 0;
+
+    allocation_counter counter;
+    f.on_ready([&a, &b, &c](expected<int, std::exception_ptr> const& v) { a = b = c = *v; });
+    p.set_value(1);
+    REQUIRE(a + b + c == 3);
+    REQUIRE(counter.count() == 0);
+}
+
+TEST_CASE("Watching and reaping a future does not allocate", "[allocation][ready_queue]") {
+    ready_queue q(16);
+    promise<int> p;
+    auto f = p.get_future();
+
+    allocation_counter counter;
+    q.watch(f, 1);
+    p.set_value(1);
+    std::uint64_t seen = 0;
+    REQUIRE(q.reap([&seen](std::uint64_t id) { seen = id; }) == 1);
+    REQUIRE(seen == 1);
+    REQUIRE(counter.count() == 0);
+}
+
+TEST_CASE("A batch of results costs a single allocation", "[allocation][batch_future]") {
+    allocation_counter counter;
+    batch_promise<int> batch(10000);
+    auto results = batch.get_future();
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+        batch.set_value(i, static_cast<int>(i));
+    }
+    REQUIRE(results.get().size() == 10000);
+    REQUIRE(counter.count() == 1);
+}
+
+TEST_CASE("Nested future forwards without an extra hop", "[allocation]") {
+    promise<int> inner;
+    promise<int> p;
+    auto f = p.get_future();
+    auto g = inner.get_future();
+
+    allocation_counter counter;
+    auto result = f.then([&g](int) { return g; });
+    p.set_value(1);
+    inner.set_value(2);
+    REQUIRE(result.get() == 2);
+    REQUIRE(counter.count() == 1);
+}
+
+TEST_CASE("Composed senders allocate nothing", "[allocation][sender]") {
+    inline_executor ex;
+
+    allocation_counter counter;
+    auto result = lazy::sync_wait(lazy::when_all(
+            lazy::just(1).then([](int v) { return v + 1; }).on(ex),
+            lazy::just(2).on(ex).then([](int v) { return v * 2; })));
+
+    REQUIRE(*std::get<0>(*result) == 2);
+    REQUIRE(*std::get<1>(*result) == 4);
+    REQUIRE(counter.count() == 0);
+}
+
+TEST_CASE("A sender bridged to a future costs a single allocation", "[allocation][sender]") {
+    allocation_counter counter;
+    auto f = lazy::as_future(lazy::just(1).then([](int v) { return v + 1; }));
+    REQUIRE(f.get() == 2);
+    REQUIRE(counter.count() == 1);
+}
@@ -0,0 +1,114 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+#include "batch_future.hpp"
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace hntr::platform;
+
+TEST_CASE("A batch completes once every slot has", "[batch_future]") {
+    batch_promise<int> batch(3);
+    auto results = batch.get_future();
+    REQUIRE(results.size() == 3);
+
+    batch.set_value(2, 20);
+    batch.set_value(0, 0);
+    REQUIRE(!results.is_ready());
+    REQUIRE(**results.try_get(2) == 20);
+    REQUIRE(!results.try_get(1));
+
+    batch.set_exception(1, std::logic_error("Custom error"));
+    REQUIRE(results.is_ready());
+
+    auto all = results.get();
+    REQUIRE(all.size() == 3);
+    REQUIRE(*all[0] == 0);
+    REQUIRE(!all[1]);
+    CHECK_THROWS_AS(std::rethrow_exception(all[1].error()), std::logic_error);
+    REQUIRE(*all[2] == 20);
+}
+
+TEST_CASE("The all-done future chains like any other", "[batch_future]") {
+    batch_promise<std::string> batch(4);
+    auto joined = batch.get_future().done().then([](std::span<expected<std::string, std::exception_ptr> const> all) {
+        std::string s;
+        for (auto& r : all) {
+            s += *r;
+        }
+        return s;
+    });
+    for (std::size_t i = 0; i < 4; ++i) {
+        batch.set_value(i, std::string(1, char('a' + i)));
+    }
+    REQUIRE(joined.get() == "abcd");
+}
+
+TEST_CASE("An empty batch is ready at once", "[batch_future]") {
+    batch_promise<int> batch(0);
+    auto results = batch.get_future();
+    REQUIRE(results.is_ready());
+    REQUIRE(results.get().empty());
+}
+
+TEST_CASE("Per-slot callbacks report every slot once", "[batch_future]") {
+    batch_promise<int, int> batch(4);
+    auto results = batch.get_future();
+    batch.set_value(1, 10);
+
+    std::vector<std::size_t> seen;
+    results.on_each([&seen](std::size_t index, expected<int, int> const&) { seen.push_back(index); });
+    REQUIRE(seen == std::vector<std::size_t>{1});
+
+    batch.set_value(3, 30);
+    batch.set_exception(0, 5);
+    batch.set_value(2, 20);
+    REQUIRE(seen == std::vector<std::size_t>{1, 3, 0, 2});
+}
+
+TEST_CASE("Void batches count completions", "[batch_future]") {
+    batch_promise<void> batch(2);
+    auto results = batch.get_future();
+    batch.set_value(0);
+    batch.set_value(1);
+    REQUIRE(results.get().size() == 2);
+}
+
+TEST_CASE("Slots are completed from many threads while a callback attaches", "[batch_future][stress]") {
+    constexpr std::size_t size = 10000;
+    constexpr int threads = 4;
+
+    for (int round = 0; round < 10; ++round) {
+        batch_promise<std::size_t, int> batch(size);
+        auto results = batch.get_future();
+        std::atomic<std::size_t> reported{0};
+        std::vector<std::atomic<int>> counts(size);
+
+        std::vector<std::thread> producers;
+        for (int t = 0; t < threads; ++t) {
+            producers.emplace_back([&batch, t]() {
+                for (std::size_t i = t; i < size; i += threads) {
+                    batch.set_value(i, i);
+                }
+            });
+        }
+        results.on_each([&](std::size_t index, expected<std::size_t, int> const& r) {
+            ++counts[index];
+            reported += *r == index;
+        });
+        for (auto& p : producers) {
+            p.join();
+        }
+
+        REQUIRE(reported == size);
+        for (auto& c : counts) {
+            REQUIRE(c == 1);
+        }
+        REQUIRE(results.get().size() == size);
+    }
+}
@@ -0,0 +1,536 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "batch_future.hpp"
+#include "expected_array.hpp"
+#include "future.hpp"
+#include "thread_pool.hpp"
+#include "when_all.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory_resource>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+using namespace hntr::platform;
+
+namespace {
+
+// Baseline for the work-stealing pool: one mutex-protected FIFO shared by all
+// workers.
+class mutex_queue_pool final : public Executor {
+public:
+    explicit mutex_queue_pool(std::size_t threads) {
+        for (std::size_t i = 0; i < threads; ++i) {
+            _threads.emplace_back([this]() { run(); });
+        }
+    }
+
+    ~mutex_queue_pool() {
+        {
+            std::lock_guard lock(_mutex);
+            _stop = true;
+        }
+        _cond.notify_all();
+        for (auto& t : _threads) {
+            t.join();
+        }
+    }
+
+    void post(task& t) override {
+        {
+            std::lock_guard lock(_mutex);
+            _queue.push_back(&t);
+        }
+        _cond.notify_one();
+    }
+
+private:
+    void run() {
+        std::unique_lock lock(_mutex);
+        while (true) {
+            _cond.wait(lock, [this]() { return _stop || !_queue.empty(); });
+            if (_queue.empty()) {
+                return;
+            }
+            auto t = _queue.front();
+            _queue.pop_front();
+            lock.unlock();
+            t->run();
+            lock.lock();
+        }
+    }
+
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::deque<task*> _queue;
+    bool _stop = false;
+    std::vector<std::thread> _threads;
+};
+
+std::size_t pool_size() {
+    return std::max(2u, std::thread::hardware_concurrency());
+}
+
+// 64 roots each fanning out 64 leaves; joins on the last leaf.
+int fork_join(Executor& ex) {
+    constexpr int roots = 64;
+    constexpr int leaves = 64;
+    std::atomic<int> remaining{roots * leaves};
+    promise<int> done;
+
+    for (int r = 0; r < roots; ++r) {
+        post(ex, [&]() {
+            for (int l = 0; l < leaves; ++l) {
+                post(ex, [&]() {
+                    if (remaining.fetch_sub(1) == 1) {
+                        done.set_value(roots * leaves);
+                    }
+                });
+            }
+        });
+    }
+    return done.get_future().get();
+}
+
+// 64 independent ten-stage then() chains, every hop scheduled on the pool.
+int chains(Executor& ex) {
+    std::vector<promise<int>> promises(64);
+    std::vector<future<int, std::exception_ptr>> results;
+    results.reserve(promises.size());
+
+    for (auto& p : promises) {
+        auto f = p.get_future().via(ex);
+        for (int i = 0; i < 10; ++i) {
+            f = f.then([](int v) { return v + 1; });
+        }
+        results.push_back(std::move(f));
+    }
+    for (auto& p : promises) {
+        p.set_value(0);
+    }
+
+    int sum = 0;
+    for (auto& r : results) {
+        sum += r.get();
+    }
+    return sum;
+}
+
+// Same error with a user-provided copy, which makes the expected holding it
+// non-trivial and forces it to be returned through memory.
+struct nontrivial_errc {
+    nontrivial_errc(std::errc e) : value(e) {}
+    nontrivial_errc(nontrivial_errc const& o) : value(o.value) {}
+    std::errc value;
+};
+
+template <typename E>
+[[gnu::noinline]] expected<int, E> checked_half(int v) {
+    if (v % 7 == 0) {
+        return unexpected(E(std::errc::invalid_argument));
+    }
+    return expected<int, E>(v / 2);
+}
+
+template <typename E>
+int sum_checked_halves(int n) {
+    int sum = 0;
+    for (int i = 0; i < n; ++i) {
+        if (auto r = checked_half<E>(i)) {
+            sum += *r;
+        }
+    }
+    return sum;
+}
+
+expected<int, std::errc> validated(int v) {
+    if (v % 97 == 0) {
+        return unexpected(std::errc::invalid_argument);
+    }
+    return expected<int, std::errc>(v);
+}
+
+int bumped(int v) {
+    return v + 3;
+}
+
+// Ten validation steps through the combinators...
+int validate_composed(int v) {
+    auto r = validated(v)
+            .transform(bumped).and_then(validated)
+            .transform(bumped).and_then(validated)
+            .transform(bumped).and_then(validated)
+            .transform(bumped).and_then(validated)
+            .transform(bumped);
+    return r ? *r : -1;
+}
+
+// ...and the same steps written out by hand.
+int validate_by_hand(int v) {
+    for (int i = 0; i < 4; ++i) {
+        if (!validated(v)) {
+            return -1;
+        }
+        v = bumped(v);
+    }
+    return validated(v) ? bumped(v) : -1;
+}
+
+future<int, std::exception_ptr> increment(future<int, std::exception_ptr> f) {
+    co_return co_await f + 1;
+}
+
+} // namespace
+
+TEST_CASE("set_value to continuation hop", "[benchmark][future]") {
+    BENCHMARK("continuation attached before set_value") {
+        promise<int> p;
+        auto f = p.get_future().then([](int v) { return v + 1; });
+        p.set_value(1);
+        return f.get();
+    };
+
+    BENCHMARK("continuation attached after set_value") {
+        promise<int> p;
+        p.set_value(1);
+        return p.get_future().then([](int v) { return v + 1; }).get();
+    };
+
+    BENCHMARK("on_ready attached before set_value") {
+        promise<int> p;
+        int result = 0;
+        p.get_future().on_ready([&result](expected<int, std::exception_ptr> const& v) { result = *v + 1; });
+        p.set_value(1);
+        return result;
+    };
+
+    BENCHMARK("ten stage chain") {
+        promise<int> p;
+        auto f = p.get_future()
+                .then([](int v) { return v + 1; })
+                .then([](int v) { return v + 1; })
+                .then([](int v) { return v + 1; })
+                .then([](int v) { return v + 1; })
+                .then([](int v) { return v + 1; })
+                .then([](int v) { return v + 1; })
+                .then([](int v) { return v + 1; })
+                .then([](int v) { return v + 1; })
+                .then([](int v) { return v + 1; })
+                .then([](int v) { return v + 1; });
+        p.set_value(1);
+        return f.get();
+    };
+
+    BENCHMARK("ten stage fused pipeline") {
+        promise<int> p;
+        future<int, std::exception_ptr> f = p.get_future().pipe()
+                .then([](int v) { return v + 1; })
+                .then([](int v) { return v + 1; })
+                .then([](int v) { return v + 1; })
+                .then([](int v) { return v + 1; })
+                .then([](int v) { return v + 1; })
+                .then([](int v) { return v + 1; })
+                .then([](int v) { return v + 1; })
+                .then([](int v) { return v + 1; })
+                .then([](int v) { return v + 1; })
+                .then([](int v) { return v + 1; });
+        p.set_value(1);
+        return f.get();
+    };
+
+    BENCHMARK("ten stage coroutine pipeline") {
+        promise<int> p;
+        auto f = p.get_future();
+        for (int i = 0; i < 10; ++i) {
+            f = increment(std::move(f));
+        }
+        p.set_value(1);
+        return f.get();
+    };
+}
+
+TEST_CASE("Work-stealing pool against a mutex queue pool", "[benchmark][thread_pool]") {
+    thread_pool stealing(pool_size());
+    mutex_queue_pool naive(pool_size());
+
+    BENCHMARK("fork/join, work-stealing pool") {
+        return fork_join(stealing);
+    };
+
+    BENCHMARK("fork/join, mutex queue pool") {
+        return fork_join(naive);
+    };
+
+    BENCHMARK("then() chains, work-stealing pool") {
+        return chains(stealing);
+    };
+
+    BENCHMARK("then() chains, mutex queue pool") {
+        return chains(naive);
+    };
+}
+
+TEST_CASE("Error path throughput", "[benchmark][future][typed_error]") {
+    auto step = [](int v) { return v + 1; };
+
+    BENCHMARK("failed request through three stages, exception_ptr") {
+        promise<int> p;
+        auto f = p.get_future().then(step).then(step).then(step);
+        p.set_exception(std::runtime_error("failed"));
+        return !f.result();
+    };
+
+    BENCHMARK("failed request through three stages, error_code") {
+        promise<int, std::error_code> p;
+        auto f = p.get_future().then(step).then(step).then(step);
+        p.set_exception(std::make_error_code(std::errc::timed_out));
+        return !f.result();
+    };
+
+    BENCHMARK("handler failure, exception_ptr") {
+        promise<int> p;
+        auto f = p.get_future()
+                .then([](int) -> int { throw std::runtime_error("failed"); })
+                .then(step).then(step);
+        p.set_value(1);
+        return !f.result();
+    };
+
+    BENCHMARK("handler failure, error_code") {
+        promise<int, std::error_code> p;
+        auto f = p.get_future()
+                .then([](int) -> expected<int, std::error_code> { return unexpected(std::make_error_code(std::errc::timed_out)); })
+                .then(step).then(step);
+        p.set_value(1);
+        return !f.result();
+    };
+}
+
+TEST_CASE("Returning expected from a call", "[benchmark][expected]") {
+    // expected<int, errc> is trivially copyable and eight bytes, so it comes
+    // back in a register; the non-trivial one is returned through the stack.
+    static_assert(std::is_trivially_copyable_v<expected<int, std::errc>>);
+    static_assert(!std::is_trivially_copyable_v<expected<int, nontrivial_errc>>);
+
+    BENCHMARK("1000 calls, trivially copyable expected") {
+        return sum_checked_halves<std::errc>(1000);
+    };
+
+    BENCHMARK("1000 calls, non-trivial expected") {
+        return sum_checked_halves<nontrivial_errc>(1000);
+    };
+}
+
+TEST_CASE("Ten step validation", "[benchmark][expected]") {
+    std::vector<int> inputs(1000);
+    for (int i = 0; i < 1000; ++i) {
+        inputs[i] = i * 31;
+    }
+
+    BENCHMARK("and_then/transform pipeline") {
+        int sum = 0;
+        for (int v : inputs) {
+            sum += validate_composed(v);
+        }
+        return sum;
+    };
+
+    BENCHMARK("hand-written branches") {
+        int sum = 0;
+        for (int v : inputs) {
+            sum += validate_by_hand(v);
+        }
+        return sum;
+    };
+}
+
+TEST_CASE("Columnar results against a vector of expected", "[benchmark][expected_array]") {
+    constexpr std::size_t size = 1 << 20;
+    std::vector<expected<int, std::error_code>> rows;
+    rows.reserve(size);
+    expected_array<int, std::error_code> columns(size);
+    for (std::size_t i = 0; i < size; ++i) {
+        if (i % 13 == 0) {
+            rows.emplace_back(unexpected(std::make_error_code(std::errc::timed_out)));
+            columns.set_error(i, std::make_error_code(std::errc::timed_out));
+        } else {
+            rows.emplace_back(static_cast<int>(i));
+            columns.set_value(i, static_cast<int>(i));
+        }
+    }
+
+    BENCHMARK("count errors, vector of expected") {
+        std::size_t n = 0;
+        for (auto const& r : rows) {
+            n += !r;
+        }
+        return n;
+    };
+
+    BENCHMARK("count errors, expected_array") {
+        return columns.count_errors();
+    };
+
+    BENCHMARK("scale values, vector of expected") {
+        std::vector<expected<int, std::error_code>> out;
+        out.reserve(size);
+        for (auto const& r : rows) {
+            out.push_back(r.transform([](int v) { return v * 3; }));
+        }
+        return out.size();
+    };
+
+    BENCHMARK("scale values, expected_array") {
+        return columns.transform_values([](int v) { return v * 3; }).size();
+    };
+}
+
+TEST_CASE("Fan-out of 10k results", "[benchmark][batch_future]") {
+    constexpr std::size_t size = 10000;
+
+    BENCHMARK("promise per result, when_all") {
+        std::vector<promise<int>> promises(size);
+        std::vector<future<int, std::exception_ptr>> futures;
+        futures.reserve(size);
+        for (auto& p : promises) {
+            futures.push_back(p.get_future());
+        }
+        auto joined = when_all(futures);
+        for (std::size_t i = 0; i < size; ++i) {
+            promises[i].set_value(static_cast<int>(i));
+        }
+        return joined.get().size();
+    };
+
+    BENCHMARK("batch_promise") {
+        batch_promise<int> batch(size);
+        auto results = batch.get_future();
+        for (std::size_t i = 0; i < size; ++i) {
+            batch.set_value(i, static_cast<int>(i));
+        }
+        return results.get().size();
+    };
+}
+
+TEST_CASE("Polling futures from an event loop", "[benchmark][future]") {
+    constexpr int inputs = 4096;
+    std::vector<promise<int>> promises(inputs);
+    std::vector<future<int, std::exception_ptr>> futures;
+    for (auto& p : promises) {
+        futures.push_back(p.get_future());
+    }
+    for (int i = 0; i < inputs; i += 16) {
+        promises[i].set_value(i);
+    }
+    std::vector<std::size_t> ready;
+    ready.reserve(inputs);
+
+    BENCHMARK("poll_ready over 4096 futures") {
+        ready.clear();
+        return poll_ready(futures, ready);
+    };
+
+    BENCHMARK("timed get over 4096 futures") {
+        std::size_t count = 0;
+        for (auto& f : futures) {
+            count += !!f.get(std::chrono::milliseconds(0));
+        }
+        return count;
+    };
+}
+
+TEST_CASE("Blocking get() wake-up", "[benchmark][future]") {
+    BENCHMARK("256 ping-pong round trips between two threads") {
+        constexpr int rounds = 256;
+        std::vector<promise<int>> ping(rounds);
+        std::vector<promise<int>> pong(rounds);
+
+        std::thread peer([&]() {
+            for (int i = 0; i < rounds; ++i) {
+                pong[i].set_value(ping[i].get_future().get() + 1);
+            }
+        });
+        int result = 0;
+        for (int i = 0; i < rounds; ++i) {
+            ping[i].set_value(result);
+            result = pong[i].get_future().get();
+        }
+        peer.join();
+        return result;
+    };
+
+    BENCHMARK("set_value with no reader") {
+        promise<int> p;
+        p.set_value(1);
+        return p.get_future().get();
+    };
+}
+
+TEST_CASE("Joining 64 futures", "[benchmark][when_all]") {
+    BENCHMARK("when_all over a range") {
+        std::vector<promise<int>> promises(64);
+        std::vector<future<int, std::exception_ptr>> futures;
+        futures.reserve(promises.size());
+        for (auto& p : promises) {
+            futures.push_back(p.get_future());
+        }
+        auto all = when_all(futures);
+        for (auto& p : promises) {
+            p.set_value(1);
+        }
+        return all.get().size();
+    };
+
+    BENCHMARK("then() on every input and a shared counter") {
+        std::vector<promise<int>> promises(64);
+        std::vector<future<int, std::exception_ptr>> futures;
+        futures.reserve(promises.size());
+        std::atomic<int> remaining{64};
+        promise<int> done;
+        for (auto& p : promises) {
+            futures.push_back(p.get_future().then([&](int v) {
+                if (remaining.fetch_sub(1) == 1) {
+                    done.set_value(v);
+                }
+                return v;
+            }));
+        }
+        for (auto& p : promises) {
+            p.set_value(1);
+        }
+        return done.get_future().get();
+    };
+}
+
+TEST_CASE("Per-request chain allocation", "[benchmark][pmr]") {
+    auto request = [](promise<int>& p) {
+        auto f = p.get_future()
+                .then([](int v) { return v + 1; })
+                .then([](int v) { return v + 1; })
+                .then([](int v) { return v + 1; })
+                .then([](int v) { return v + 1; })
+                .then([](int v) { return v + 1; });
+        p.set_value(1);
+        return f.get();
+    };
+
+    BENCHMARK("five stage chain, default allocator") {
+        promise<int> p;
+        return request(p);
+    };
+
+    BENCHMARK("five stage chain, monotonic arena") {
+        char buffer[2048];
+        std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer));
+        promise<int> p(std::allocator_arg, &arena);
+        return request(p);
+    };
+}
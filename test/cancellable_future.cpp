@@ -0,0 +1,190 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+#include "cancellable_future.hpp"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <stop_token>
+#include <system_error>
+#include <thread>
+
+using namespace hntr::platform;
+
+namespace {
+
+class queue_executor : public Executor {
+public:
+    void post(task& t) override {
+        _queue.push_back(&t);
+    }
+
+    std::size_t run() {
+        std::size_t count = 0;
+        while (!_queue.empty()) {
+            auto t = _queue.front();
+            _queue.pop_front();
+            t->run();
+            ++count;
+        }
+        return count;
+    }
+
+private:
+    std::deque<task*> _queue;
+};
+
+} // namespace
+
+TEST_CASE("Cancelled stages do not run", "[cancellable_future]") {
+    promise<int> p;
+    cancellable_future<int, std::exception_ptr> head(p.get_future());
+
+    int runs = 0;
+    auto tail = head
+            .then([&](int v) { ++runs; return v + 1; })
+            .then([&](int v) { ++runs; return v + 1; });
+
+    REQUIRE(tail.cancel());
+    REQUIRE(!tail.cancel());
+    REQUIRE(head.cancelled());
+
+    CHECK_THROWS_AS(tail.get(), operation_cancelled);
+    p.set_value(1);
+    REQUIRE(runs == 0);
+}
+
+TEST_CASE("Chains with std::error_code errors complete with operation_canceled", "[cancellable_future][typed_error]") {
+    promise<int, std::error_code> p;
+    cancellable_future<int, std::error_code> head(p.get_future());
+
+    int runs = 0;
+    auto tail = head.then([&](int v) { ++runs; return v + 1; });
+
+    REQUIRE(tail.cancel());
+    REQUIRE(!tail.result());
+    REQUIRE(tail.result().error() == std::errc::operation_canceled);
+    p.set_value(1);
+    REQUIRE(runs == 0);
+}
+
+TEST_CASE("Cancellation releases captured state immediately", "[cancellable_future]") {
+    promise<int> p;
+    cancellable_future<int, std::exception_ptr> head(p.get_future());
+
+    auto payload = std::make_shared<int>(42);
+    auto tail = head
+            .then([payload](int v) { return v + *payload; })
+            .then([payload](int v) { return v * *payload; });
+    REQUIRE(payload.use_count() == 3);
+
+    head.cancel();
+    REQUIRE(payload.use_count() == 1);
+}
+
+TEST_CASE("Producers observe cancellation through the stop token", "[cancellable_future]") {
+    promise<int> p;
+    cancellable_future<int, std::exception_ptr> head(p.get_future());
+    auto token = head.get_stop_token();
+
+    bool notified = false;
+    std::stop_callback on_stop(token, [&]() { notified = true; });
+
+    auto tail = head.then([](int v) { return v; });
+    REQUIRE(!token.stop_requested());
+    tail.cancel();
+    REQUIRE(token.stop_requested());
+    REQUIRE(notified);
+}
+
+TEST_CASE("Cancelling a finished chain keeps its value", "[cancellable_future]") {
+    promise<int> p;
+    cancellable_future<int, std::exception_ptr> head(p.get_future());
+    auto tail = head.then([](int v) { return v + 1; });
+    p.set_value(1);
+
+    tail.cancel();
+    REQUIRE(tail.get() == 2);
+}
+
+TEST_CASE("Stages after a cancelled stage complete with the error", "[cancellable_future]") {
+    promise<int> p;
+    cancellable_future<int, std::exception_ptr> head(p.get_future());
+    auto tail = head.then([](int v) { return v + 1; });
+    tail.cancel();
+
+    int runs = 0;
+    auto later = tail.then([&](int v) { ++runs; return v; });
+    CHECK_THROWS_AS(later.get(), operation_cancelled);
+    REQUIRE(runs == 0);
+}
+
+TEST_CASE("A stage cancelled while queued does not run", "[cancellable_future]") {
+    queue_executor ex;
+    promise<int> p;
+    cancellable_future<int, std::exception_ptr> head(p.get_future());
+
+    auto payload = std::make_shared<int>(1);
+    int runs = 0;
+    auto tail = head.then(ex, [&, payload](int v) { ++runs; return v + *payload; });
+
+    p.set_value(1);
+    REQUIRE(payload.use_count() == 2);
+    tail.cancel();
+    REQUIRE(payload.use_count() == 1);
+
+    REQUIRE(ex.run() == 1);
+    REQUIRE(runs == 0);
+    CHECK_THROWS_AS(tail.get(), operation_cancelled);
+}
+
+TEST_CASE("Chains attached after cancellation complete cancelled", "[cancellable_future]") {
+    promise<int> p;
+    cancellable_future<int, std::exception_ptr> head(p.get_future());
+    head.cancel();
+
+    auto tail = head.then([](int v) { return v; });
+    CHECK_THROWS_AS(tail.get(), operation_cancelled);
+    p.set_value(1);
+}
+
+TEST_CASE("Cancellation from another thread stops a polling producer", "[cancellable_future]") {
+    promise<int> p;
+    cancellable_future<int, std::exception_ptr> head(p.get_future());
+    auto tail = head.then([](int v) { return v * 2; });
+
+    std::atomic<bool> started{false};
+    std::thread producer([&p, &started, token = head.get_stop_token()]() {
+        int work = 0;
+        started = true;
+        while (!token.stop_requested()) {
+            ++work;
+            std::this_thread::yield();
+        }
+        p.set_value(work);
+    });
+
+    while (!started) {
+        std::this_thread::yield();
+    }
+    tail.cancel();
+    producer.join();
+    CHECK_THROWS_AS(tail.get(), operation_cancelled);
+}
+
+TEST_CASE("A cancelled pipeline runs none of its stages", "[cancellable_future][pipe]") {
+    promise<int> p;
+    cancellable_future<int, std::exception_ptr> head(p.get_future());
+
+    int runs = 0;
+    auto tail = head.pipe()
+            .then([&](int v) { ++runs; return v + 1; })
+            .then([&](int v) { ++runs; return v + 1; })
+            .end();
+    tail.cancel();
+    p.set_value(1);
+
+    CHECK_THROWS_AS(tail.get(), operation_cancelled);
+    REQUIRE(runs == 0);
+}
@@ -0,0 +1,200 @@
+#define CATCH_CONFIG_MAIN 
+#include "catch.hpp"
+
+#include "executor.hpp"
+#include "future.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+using namespace hntr::platform;
+
+namespace {
+
+// Queues tasks until the test drains them explicitly.
+class manual_executor : public Executor {
+public:
+    void post(task& t) override {
+        _posted.push_back(&t);
+    }
+
+    void defer(task& t) override {
+        _deferred.push_back(&t);
+    }
+
+    bool running_in_this_thread() const override {
+        return _running;
+    }
+
+    std::size_t run() {
+        std::size_t count = 0;
+        _running = true;
+        while (!_posted.empty() || !_deferred.empty()) {
+            auto& queue = _deferred.empty() ? _posted : _deferred;
+            auto t = queue.front();
+            queue.pop_front();
+            t->run();
+            ++count;
+        }
+        _running = false;
+        return count;
+    }
+
+    std::size_t posted() const { return _posted.size(); }
+    std::size_t deferred() const { return _deferred.size(); }
+
+private:
+    std::deque<task*> _posted;
+    std::deque<task*> _deferred;
+    bool _running = false;
+};
+
+// Runs tasks on a single dedicated thread.
+class thread_executor : public Executor {
+public:
+    thread_executor() : _thread([this]() { loop(); }) {}
+
+    ~thread_executor() {
+        {
+            std::lock_guard lock(_mutex);
+            _stop = true;
+        }
+        _cond.notify_one();
+        _thread.join();
+    }
+
+    void post(task& t) override {
+        {
+            std::lock_guard lock(_mutex);
+            _queue.push_back(&t);
+        }
+        _cond.notify_one();
+    }
+
+    bool running_in_this_thread() const override {
+        return std::this_thread::get_id() == _thread.get_id();
+    }
+
+    std::thread::id id() const { return _thread.get_id(); }
+
+private:
+    void loop() {
+        std::unique_lock lock(_mutex);
+        while (true) {
+            _cond.wait(lock, [this]() { return _stop || !_queue.empty(); });
+            if (_queue.empty()) {
+                return;
+            }
+            auto t = _queue.front();
+            _queue.pop_front();
+            lock.unlock();
+            t->run();
+            lock.lock();
+        }
+    }
+
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::deque<task*> _queue;
+    bool _stop = false;
+    std::thread _thread;
+};
+
+} // namespace
+
+TEST_CASE("Posted callables run only when the executor runs them", "[executor]") {
+    manual_executor ex;
+    int runs = 0;
+    post(ex, [&runs]() { ++runs; });
+    defer(ex, [&runs]() { ++runs; });
+
+    REQUIRE(runs == 0);
+    REQUIRE(ex.posted() == 1);
+    REQUIRE(ex.deferred() == 1);
+    REQUIRE(ex.run() == 2);
+    REQUIRE(runs == 2);
+}
+
+TEST_CASE("Dispatch runs inline only on the executor", "[executor]") {
+    manual_executor ex;
+    int runs = 0;
+    dispatch(ex, [&]() {
+        ++runs;
+        dispatch(ex, [&runs]() { ++runs; });
+        REQUIRE(runs == 2);
+    });
+
+    REQUIRE(runs == 0);
+    ex.run();
+    REQUIRE(runs == 2);
+}
+
+TEST_CASE("Continuation is scheduled on the given executor", "[executor][future]") {
+    manual_executor ex;
+    promise<int> p;
+    auto future = p.get_future().then(ex, [](int val) {
+        return val * 2;
+    });
+
+    p.set_value(21);
+    REQUIRE(!future.get(std::chrono::milliseconds{1}));
+    REQUIRE(ex.run() == 1);
+    REQUIRE(future.get() == 42);
+}
+
+TEST_CASE("Continuation runs on the executor thread, not the producer", "[executor][future]") {
+    thread_executor ex;
+    promise<std::string> p;
+    auto future = p.get_future().then(ex, [](std::string) {
+        return std::this_thread::get_id();
+    });
+
+    std::thread([&p]() { p.set_value("blah"); }).join();
+    REQUIRE(future.get() == ex.id());
+}
+
+TEST_CASE("Executor set with via() applies to the whole chain", "[executor][future]") {
+    manual_executor ex;
+    promise<int> p;
+    auto future = p.get_future().via(ex)
+            .then([](int val) { return val + 1; })
+            .then([](int val) { return val * 2; });
+
+    p.set_value(1);
+    REQUIRE(ex.posted() == 1);
+    REQUIRE(ex.run() == 2);
+    REQUIRE(future.get() == 4);
+}
+
+TEST_CASE("Policy set with via() selects the submission kind", "[executor][future]") {
+    manual_executor ex;
+    promise<int> p;
+    auto future = p.get_future().via(ex, schedule::defer)
+            .then([](int val) { return val + 1; });
+
+    p.set_value(1);
+    REQUIRE(ex.deferred() == 1);
+    REQUIRE(ex.posted() == 0);
+    ex.run();
+    REQUIRE(future.get() == 2);
+}
+
+TEST_CASE("Errors are delivered through the executor", "[executor][future]") {
+    manual_executor ex;
+    bool isRun = false;
+    promise<int> p;
+    auto future = p.get_future().via(ex)
+            .then([](int) -> int { throw std::runtime_error("Something happened"); })
+            .then([&isRun](int val) {
+                isRun = true;
+                return val;
+            });
+
+    p.set_value(1);
+    ex.run();
+    CHECK_THROWS_AS(future.get(), std::runtime_error);
+    REQUIRE(!isRun);
+}
@@ -3,6 +3,9 @@
 
 #include "expected.hpp"
 
+#include <string>
+#include <type_traits>
+
 using namespace hntr::platform;
 
 TEST_CASE("expected is expected", "[expected]") {
@@ -36,3 +39,165 @@ TEST_CASE("void is ok", "[expected]") {
 }
 
 
+TEST_CASE("expected over trivial types is trivially copyable", "[expected][trivial]") {
+    enum class failure : unsigned char { timeout, refused };
+
+    STATIC_REQUIRE(std::is_trivially_copyable_v<expected<int, failure>>);
+    STATIC_REQUIRE(std::is_trivially_copyable_v<expected<int*, int>>);
+    STATIC_REQUIRE(std::is_trivially_copyable_v<expected<void, failure>>);
+    STATIC_REQUIRE(std::is_trivially_destructible_v<expected<int, failure>>);
+    STATIC_REQUIRE(sizeof(expected<int, failure>) == 2 * sizeof(int));
+
+    STATIC_REQUIRE(!std::is_trivially_copyable_v<expected<std::string, int>>);
+    STATIC_REQUIRE(!std::is_trivially_copyable_v<expected<int, std::string>>);
+    STATIC_REQUIRE(!std::is_trivially_copyable_v<expected<void, std::string>>);
+}
+
+namespace {
+
+constexpr expected<int, int> parse_digit(char c) {
+    if (c < '0' || c > '9') {
+        return unexpected(int(c));
+    }
+    return expected<int, int>(c - '0');
+}
+
+constexpr int sum_digits(char const* s) {
+    int sum = 0;
+    for (; *s; ++s) {
+        auto d = parse_digit(*s);
+        if (!d) {
+            return -d.error();
+        }
+        auto copy = d;
+        copy = parse_digit(*s);
+        sum += *copy;
+    }
+    return sum;
+}
+
+} // namespace
+
+TEST_CASE("expected over trivial types works in constant expressions", "[expected][trivial]") {
+    STATIC_REQUIRE(sum_digits("1234") == 10);
+    STATIC_REQUIRE(sum_digits("12x4") == -'x');
+    STATIC_REQUIRE(!expected<void, int>(unexpected(1)));
+}
+
+TEST_CASE("Non-trivial expected copies and assigns its active member", "[expected]") {
+    expected<std::string, std::string> a(std::string("aaa"));
+    expected<std::string, std::string> b(unexpected(std::string("bbb")));
+
+    auto c = a;
+    REQUIRE(*c == "aaa");
+    c = b;
+    REQUIRE(c.error() == "bbb");
+    c = std::move(a);
+    REQUIRE(*c == "aaa");
+    auto& self = c;
+    c = self;
+    REQUIRE(*c == "aaa");
+    c = unexpected(std::string("ccc"));
+    REQUIRE(c.error() == "ccc");
+
+    expected<void, std::string> v(unexpected(std::string("ddd")));
+    auto w = v;
+    REQUIRE(w.error() == "ddd");
+    w = expected<void, std::string>();
+    REQUIRE(w);
+}
+
+namespace {
+
+struct counted {
+    static inline int copies = 0;
+
+    counted() = default;
+    explicit counted(std::string v) : value(std::move(v)) {}
+    counted(counted const& o) : value(o.value) { ++copies; }
+    counted(counted&&) noexcept = default;
+    counted& operator= (counted const& o) { value = o.value; ++copies; return *this; }
+    counted& operator= (counted&&) noexcept = default;
+
+    std::string value;
+};
+
+constexpr expected<int, int> positive(int v) {
+    if (v <= 0) {
+        return unexpected(v);
+    }
+    return expected<int, int>(v);
+}
+
+} // namespace
+
+TEST_CASE("and_then chains expected-returning steps", "[expected][monadic]") {
+    auto r = positive(3)
+            .and_then([](int v) { return positive(v - 1); })
+            .and_then([](int v) { return expected<std::string, int>(std::to_string(v)); });
+    REQUIRE(*r == "2");
+
+    int runs = 0;
+    auto failed = positive(1)
+            .and_then([](int v) { return positive(v - 1); })
+            .and_then([&runs](int v) { ++runs; return positive(v); });
+    REQUIRE(failed.error() == 0);
+    REQUIRE(runs == 0);
+}
+
+TEST_CASE("transform maps the value and keeps the error", "[expected][monadic]") {
+    REQUIRE(*positive(20).transform([](int v) { return v * 2 + 2; }) == 42);
+    REQUIRE(positive(-1).transform([](int v) { return std::to_string(v); }).error() == -1);
+
+    int seen = 0;
+    expected<void, int> done = positive(5).transform([&seen](int v) { seen = v; });
+    REQUIRE(done);
+    REQUIRE(seen == 5);
+}
+
+TEST_CASE("or_else and transform_error act on the error", "[expected][monadic]") {
+    auto recovered = positive(-4).or_else([](int e) { return expected<int, std::string>(-e); });
+    REQUIRE(*recovered == 4);
+
+    auto untouched = positive(4).or_else([](int) -> expected<int, std::string> { return unexpected(std::string("no")); });
+    REQUIRE(*untouched == 4);
+
+    auto described = positive(-4).transform_error([](int e) { return "bad " + std::to_string(e); });
+    REQUIRE(described.error() == "bad -4");
+    REQUIRE(*positive(4).transform_error([](int e) { return std::to_string(e); }) == 4);
+
+    expected<void, int> failed(unexpected(7));
+    REQUIRE(failed.transform_error([](int e) { return e * 2; }).error() == 14);
+    REQUIRE(failed.or_else([](int) { return expected<void, int>(); }));
+}
+
+TEST_CASE("Combinators move out of rvalues", "[expected][monadic][move]") {
+    counted::copies = 0;
+    auto r = expected<counted, int>(counted("a"))
+            .transform([](counted c) { c.value += "b"; return c; })
+            .and_then([](counted c) { c.value += "c"; return expected<counted, int>(std::move(c)); })
+            .transform_error([](int e) { return e; })
+            .or_else([](int) { return expected<counted, int>(counted("x")); });
+    REQUIRE((*r).value == "abc");
+    REQUIRE(counted::copies == 0);
+
+    // On an lvalue the value stays where it is and handlers see a reference.
+    expected<counted, int> kept(counted("a"));
+    auto size = kept.transform([](counted const& c) { return c.value.size(); });
+    REQUIRE(*size == 1);
+    REQUIRE((*kept).value == "a");
+    REQUIRE(counted::copies == 0);
+}
+
+TEST_CASE("Combinators work in constant expressions", "[expected][monadic][trivial]") {
+    constexpr auto r = positive(4)
+            .and_then([](int v) { return positive(v - 1); })
+            .transform([](int v) { return v * 10; })
+            .transform_error([](int e) { return e - 100; });
+    STATIC_REQUIRE(*r == 30);
+
+    constexpr auto failed = positive(0)
+            .transform([](int v) { return v * 10; })
+            .or_else([](int e) { return expected<int, int>(e + 1); });
+    STATIC_REQUIRE(*failed == 1);
+}
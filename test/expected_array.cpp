@@ -0,0 +1,126 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+#include "expected_array.hpp"
+
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+using namespace hntr::platform;
+
+TEST_CASE("Slots hold a value or an error", "[expected_array]") {
+    expected_array<int, std::errc> results(3);
+    results.set_value(0, 10);
+    results.set_error(1, std::errc::timed_out);
+    results.set(2, expected<int, std::errc>(30));
+
+    REQUIRE(results.has_value(0));
+    REQUIRE(results.value(0) == 10);
+    REQUIRE(!results.has_value(1));
+    REQUIRE(results.error(1) == std::errc::timed_out);
+    REQUIRE(*results[2] == 30);
+    REQUIRE(results[1].error() == std::errc::timed_out);
+
+    results.set(0, expected<int, std::errc>(unexpected(std::errc::invalid_argument)));
+    REQUIRE(!results.has_value(0));
+}
+
+TEST_CASE("Bulk counts and compaction", "[expected_array]") {
+    constexpr std::size_t size = 200;
+    expected_array<std::string, int> results(size);
+    for (std::size_t i = 0; i < size; ++i) {
+        if (i % 3 == 0) {
+            results.set_error(i, static_cast<int>(i));
+        } else {
+            results.set_value(i, std::to_string(i));
+        }
+    }
+
+    REQUIRE(results.count_errors() == 67);
+    REQUIRE(results.count_values() == 133);
+
+    auto values = results.successes();
+    REQUIRE(values.size() == 133);
+    REQUIRE(values[0] == "1");
+    REQUIRE(values[1] == "2");
+    REQUIRE(values[2] == "4");
+    REQUIRE(values.back() == "199");
+    REQUIRE(results.value(1) == "1");
+
+    auto moved = std::move(results).successes();
+    REQUIRE(moved == values);
+}
+
+TEST_CASE("transform_values keeps errors in place", "[expected_array]") {
+    expected_array<int, std::errc> results(70);
+    for (std::size_t i = 0; i < 70; ++i) {
+        if (i == 65) {
+            results.set_error(i, std::errc::timed_out);
+        } else {
+            results.set_value(i, static_cast<int>(i));
+        }
+    }
+
+    auto doubled = results.transform_values([](int v) { return v * 2.5; });
+    REQUIRE(doubled.size() == 70);
+    REQUIRE(doubled.value(4) == 10.0);
+    REQUIRE(!doubled.has_value(65));
+    REQUIRE(doubled.error(65) == std::errc::timed_out);
+    REQUIRE(doubled.count_errors() == 1);
+
+    auto names = std::move(results).transform_values([](int v) { return std::to_string(v); });
+    REQUIRE(names.value(69) == "69");
+    REQUIRE(names.error(65) == std::errc::timed_out);
+}
+
+TEST_CASE("transform_values never sees an error slot", "[expected_array]") {
+    int values[3] = {1, 2, 3};
+    expected_array<int*, int> results(200);
+    for (std::size_t i = 0; i < 200; ++i) {
+        if (i % 7 == 3) {
+            results.set_error(i, 7);
+        } else {
+            results.set_value(i, &values[i % 3]);
+        }
+    }
+
+    std::size_t calls = 0;
+    auto read = results.transform_values([&calls](int* p) { ++calls; return *p; });
+    REQUIRE(calls == results.count_values());
+    REQUIRE(read.value(1) == 2);
+    REQUIRE(read.error(3) == 7);
+
+    calls = 0;
+    auto moved = std::move(results).transform_values([&calls](int* p) { ++calls; return *p; });
+    REQUIRE(calls == moved.count_values());
+    REQUIRE(moved.value(0) == 1);
+}
+
+TEST_CASE("Neighbouring slots may be set from different threads", "[expected_array][stress]") {
+    constexpr std::size_t size = 4096;
+    constexpr int threads = 4;
+    expected_array<std::size_t, int> results(size);
+
+    std::vector<std::thread> writers;
+    for (int t = 0; t < threads; ++t) {
+        writers.emplace_back([&results, t]() {
+            for (std::size_t i = t; i < size; i += threads) {
+                if (i % 5 == 0) {
+                    results.set_error(i, 1);
+                } else {
+                    results.set_value(i, i);
+                }
+            }
+        });
+    }
+    for (auto& w : writers) {
+        w.join();
+    }
+
+    REQUIRE(results.count_errors() == size / 5 + 1);
+    for (std::size_t i = 0; i < size; ++i) {
+        REQUIRE(results.has_value(i) == (i % 5 != 0));
+    }
+}
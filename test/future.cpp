@@ -3,10 +3,17 @@
 
 #include "future.hpp"
 
+#include <array>
+#include <memory>
+#include <span>
 #include <stdexcept>
+#include <string>
+#include <utility>
 #include <iostream>
 #include <thread>
 #include <future>
+#include <chrono>
+#include <vector>
 
 using namespace hntr::platform;
 
@@ -147,3 +154,568 @@ TEST_CASE("Futures are asynchronously chainable, void result is allowed", "[futu
     future.get();
     REQUIRE(isRun);
 }
+
+TEST_CASE("Errors of a nested future reach the outer future", "[future]") {
+    promise<int> inner;
+    promise<int> p;
+    auto future = p.get_future()
+            .then([&inner](int) {
+                return inner.get_future();
+            });
+    p.set_value(1);
+    inner.set_exception(std::logic_error("Custom error"));
+    CHECK_THROWS_AS(future.get(), std::logic_error);
+}
+
+namespace {
+
+struct counted {
+    static inline int copies = 0;
+
+    counted() = default;
+    explicit counted(std::string v) : value(std::move(v)) {}
+    counted(counted const& o) : value(o.value) { ++copies; }
+    counted(counted&&) noexcept = default;
+    counted& operator= (counted const& o) { value = o.value; ++copies; return *this; }
+    counted& operator= (counted&&) noexcept = default;
+
+    std::string value;
+};
+
+counted append(counted c) {
+    c.value += "!";
+    return c;
+}
+
+future<counted, std::exception_ptr> fulfilled(std::string v) {
+    promise<counted> p;
+    p.set_value(counted(std::move(v)));
+    return p.get_future();
+}
+
+} // namespace
+
+TEST_CASE("Values move through then() chains without copies", "[future][move]") {
+    promise<counted> p;
+    auto tail = p.get_future().then(append).then(append).then(append);
+    counted::copies = 0;
+    p.set_value(counted("blah"));
+    REQUIRE(tail.get().value == "blah!!!");
+    REQUIRE(counted::copies == 0);
+}
+
+TEST_CASE("Values move through chains attached after they arrive", "[future][move]") {
+    counted::copies = 0;
+    auto tail = fulfilled("blah").then(append).then(append);
+    REQUIRE(tail.get().value == "blah!!");
+    REQUIRE(counted::copies == 0);
+}
+
+TEST_CASE("Futures still referenced keep their value", "[future][move]") {
+    promise<counted> p;
+    auto head = p.get_future();
+    auto tail = head.then(append);
+    counted::copies = 0;
+    p.set_value(counted("blah"));
+    REQUIRE(tail.get().value == "blah!");
+    REQUIRE(head.get().value == "blah");
+    REQUIRE(counted::copies == 1);
+}
+
+TEST_CASE("Move-only handlers are moved into the chain", "[future][move]") {
+    promise<int> p;
+    inline_executor executor;
+    auto result = p.get_future()
+            .then([bonus = std::make_unique<int>(1)](int v) { return v + *bonus; })
+            .then(executor, [bonus = std::make_unique<int>(2)](int v) { return v + *bonus; });
+    p.set_value(39);
+    REQUIRE(result.get() == 42);
+}
+
+TEST_CASE("Pipeline fuses stages into one continuation", "[future][pipe]") {
+    promise<int> p;
+    future<std::string, std::exception_ptr> result = p.get_future().pipe()
+            .then([](int v) { return v + 1; })
+            .then([](int v) { return v * 2; })
+            .then([](int v) { return std::to_string(v); });
+    p.set_value(20);
+    REQUIRE(result.get() == "42");
+}
+
+TEST_CASE("Pipeline stages may return void", "[future][pipe]") {
+    promise<int> p;
+    int seen = 0;
+    auto result = p.get_future().pipe()
+            .then([&seen](int v) { seen = v; })
+            .then([&seen]() { return seen + 1; })
+            .end();
+    p.set_value(1);
+    REQUIRE(result.get() == 2);
+    REQUIRE(seen == 1);
+}
+
+TEST_CASE("Pipeline skips stages after a throw", "[future][pipe]") {
+    promise<int> p;
+    int runs = 0;
+    auto result = p.get_future().pipe()
+            .then([&runs](int v) -> int { ++runs; throw std::logic_error("Custom error"); })
+            .then([&runs](int v) { ++runs; return v; })
+            .end();
+    p.set_value(1);
+    CHECK_THROWS_AS(result.get(), std::logic_error);
+    REQUIRE(runs == 1);
+}
+
+TEST_CASE("Last pipeline stage may return a future", "[future][pipe]") {
+    promise<int> inner;
+    promise<int> p;
+    auto result = p.get_future().pipe()
+            .then([](int v) { return v + 1; })
+            .then([&inner](int) { return inner.get_future(); })
+            .end()
+            .then([](int v) { return v * 2; });
+    p.set_value(1);
+    inner.set_value(21);
+    REQUIRE(result.get() == 42);
+}
+
+TEST_CASE("Empty pipeline is the future it started from", "[future][pipe]") {
+    promise<int> p;
+    p.set_value(7);
+    REQUIRE(p.get_future().pipe().end().get() == 7);
+}
+
+TEST_CASE("try_get reads the stored result without blocking or copying", "[future][poll]") {
+    promise<counted> p;
+    auto f = p.get_future();
+    REQUIRE(!f.is_ready());
+    REQUIRE(f.try_get() == nullptr);
+
+    p.set_value(counted("blah"));
+    counted::copies = 0;
+    REQUIRE(f.is_ready());
+    auto* result = f.try_get();
+    REQUIRE(result != nullptr);
+    REQUIRE(result == f.try_get());
+    REQUIRE((**result).value == "blah");
+    REQUIRE(&**result == &f.get());
+    REQUIRE(counted::copies == 0);
+}
+
+TEST_CASE("try_get exposes errors without throwing", "[future][poll]") {
+    promise<int> p;
+    auto f = p.get_future();
+    p.set_exception(std::logic_error("Custom error"));
+    auto* result = f.try_get();
+    REQUIRE(result != nullptr);
+    REQUIRE(!*result);
+}
+
+TEST_CASE("poll_ready reports the ready futures", "[future][poll]") {
+    std::vector<promise<int>> promises(8);
+    std::vector<future<int, std::exception_ptr>> futures;
+    for (auto& p : promises) {
+        futures.push_back(p.get_future());
+    }
+    futures.emplace_back();
+
+    std::vector<std::size_t> ready;
+    REQUIRE(poll_ready(futures, ready) == 0);
+
+    promises[5].set_value(5);
+    promises[2].set_value(2);
+    REQUIRE(poll_ready(futures, ready) == 2);
+    REQUIRE(ready == std::vector<std::size_t>{2, 5});
+
+    ready.clear();
+    promises[7].set_value(7);
+    REQUIRE(poll_ready(std::span(futures).first(6), ready) == 2);
+    REQUIRE(ready == std::vector<std::size_t>{2, 5});
+}
+
+TEST_CASE("on_ready receives the result", "[future][on_ready]") {
+    promise<int> p;
+    int seen = 0;
+    p.get_future().on_ready([&seen](expected<int, std::exception_ptr> const& result) {
+        seen = *result;
+    });
+    REQUIRE(seen == 0);
+    p.set_value(7);
+    REQUIRE(seen == 7);
+}
+
+TEST_CASE("on_ready runs immediately on a fulfilled future", "[future][on_ready]") {
+    promise<std::string> p;
+    p.set_value("blah");
+    std::string seen;
+    p.get_future().on_ready([&seen](expected<std::string, std::exception_ptr> result) {
+        seen = *std::move(result);
+    });
+    REQUIRE(seen == "blah");
+}
+
+TEST_CASE("on_ready receives errors", "[future][on_ready]") {
+    promise<int> p;
+    bool failed = false;
+    p.get_future().on_ready([&failed](expected<int, std::exception_ptr> const& result) {
+        failed = !result;
+    });
+    p.set_exception(std::logic_error("Custom error"));
+    REQUIRE(failed);
+}
+
+TEST_CASE("on_ready handler is destroyed if no value ever arrives", "[future][on_ready]") {
+    auto capture = std::make_shared<int>(1);
+    auto large = std::make_shared<std::array<char, 256>>();
+    {
+        promise<int> p;
+        p.get_future().on_ready([capture](expected<int, std::exception_ptr> const&) {});
+        promise<int> q;
+        q.get_future().on_ready([capture, payload = *large](expected<int, std::exception_ptr> const&) {});
+        REQUIRE(capture.use_count() == 3);
+    }
+    REQUIRE(capture.use_count() == 1);
+}
+
+TEST_CASE("Continuation may re-enter the future it continues", "[future]") {
+    promise<int> p;
+    auto future = p.get_future();
+    auto reader = future;
+
+    auto result = future.then([&reader](int val) {
+        return val + reader.get();
+    });
+    p.set_value(21);
+
+    REQUIRE(result.get() == 42);
+}
+
+TEST_CASE("Blocked readers are released before continuations run", "[future][stress]") {
+    using clock = std::chrono::steady_clock;
+    const auto handler_cost = std::chrono::milliseconds{200};
+
+    promise<int> p;
+    auto future = p.get_future();
+    std::vector<std::future<clock::time_point>> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.push_back(std::async(std::launch::async, [reader = future]() mutable {
+            reader.get();
+            return clock::now();
+        }));
+    }
+
+    auto chained = future.then([&](int val) {
+        std::this_thread::sleep_for(handler_cost);
+        return val;
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds{50});
+    const auto published = clock::now();
+    p.set_value(1);
+
+    for (auto& r : readers) {
+        REQUIRE(r.get() - published < handler_cost / 2);
+    }
+    REQUIRE(chained.get() == 1);
+}
+
+TEST_CASE("Timed get gives up when no value arrives", "[future]") {
+    promise<int> p;
+    auto future = p.get_future();
+
+    const auto start = std::chrono::steady_clock::now();
+    REQUIRE(!future.get(std::chrono::milliseconds{50}));
+    REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds{50});
+}
+
+TEST_CASE("Timed get wakes up when the value arrives", "[future]") {
+    promise<int> p;
+    auto future = p.get_future();
+
+    const auto ap = std::async(std::launch::async, [&p]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds{50});
+        p.set_value(7);
+    });
+
+    auto result = future.get(std::chrono::seconds{10});
+    REQUIRE(result);
+    REQUIRE(*result == 7);
+}
+
+TEST_CASE("Every parked reader is woken", "[future][stress]") {
+    for (int round = 0; round < 100; ++round) {
+        promise<int> p;
+        auto future = p.get_future();
+        std::vector<std::future<int>> readers;
+        for (int i = 0; i < 4; ++i) {
+            readers.push_back(std::async(std::launch::async, [reader = future]() mutable {
+                return reader.get();
+            }));
+        }
+        p.set_value(round);
+        for (auto& r : readers) {
+            REQUIRE(r.get() == round);
+        }
+    }
+}
+
+namespace {
+
+future<int, std::exception_ptr> add_one(future<int, std::exception_ptr> input) {
+    co_return co_await input + 1;
+}
+
+future<std::string, std::exception_ptr> fail_after(future<int, std::exception_ptr> input) {
+    co_await input;
+    throw std::logic_error("Custom error");
+}
+
+future<void, std::exception_ptr> store(future<int, std::exception_ptr> input, int& target) {
+    target = co_await input;
+}
+
+} // namespace
+
+TEST_CASE("Coroutine returns a future", "[future][coroutine]") {
+    promise<int> p;
+    p.set_value(41);
+    REQUIRE(add_one(p.get_future()).get() == 42);
+}
+
+TEST_CASE("Coroutine resumes when the awaited value arrives", "[future][coroutine]") {
+    promise<int> p;
+    int target = 0;
+    auto done = store(p.get_future(), target);
+
+    REQUIRE(target == 0);
+    p.set_value(7);
+    done.get();
+    REQUIRE(target == 7);
+}
+
+TEST_CASE("Coroutine resumes on the producing thread", "[future][coroutine]") {
+    promise<int> p;
+    auto result = add_one(p.get_future());
+
+    const auto ap = std::async(std::launch::async, [&p]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds{50});
+        p.set_value(1);
+    });
+
+    REQUIRE(result.get() == 2);
+}
+
+TEST_CASE("Exceptions escape coroutines through the future", "[future][coroutine]") {
+    promise<int> p;
+    auto result = fail_after(p.get_future());
+    p.set_value(1);
+    CHECK_THROWS_AS(result.get(), std::logic_error);
+}
+
+TEST_CASE("Awaiting a failed future throws inside the coroutine", "[future][coroutine]") {
+    promise<int> p;
+    auto result = add_one(p.get_future());
+    p.set_exception(std::logic_error("Custom error"));
+    CHECK_THROWS_AS(result.get(), std::logic_error);
+}
+
+TEST_CASE("Coroutines mix with then()", "[future][coroutine]") {
+    promise<int> p;
+    auto result = add_one(p.get_future().then([](int val) { return val * 10; }))
+            .then([](int val) { return val * 2; });
+    p.set_value(2);
+    REQUIRE(result.get() == 42);
+}
+
+// Compilers only lower symmetric transfer to a tail call when optimising and
+// not instrumenting, so the full depth is only exercised in such builds.
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define AWAIT_CHAIN_INSTRUMENTED 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer)
+#define AWAIT_CHAIN_INSTRUMENTED 1
+#endif
+#endif
+
+#if defined(__OPTIMIZE__) && !defined(AWAIT_CHAIN_INSTRUMENTED)
+constexpr int await_chain_depth = 200000;
+#else
+constexpr int await_chain_depth = 1000;
+#endif
+
+TEST_CASE("Long await chains do not grow the stack", "[future][coroutine]") {
+    promise<int> p;
+    auto tail = p.get_future();
+    constexpr int depth = await_chain_depth;
+    for (int i = 0; i < depth; ++i) {
+        tail = add_one(std::move(tail));
+    }
+    p.set_value(0);
+    REQUIRE(tail.get() == depth);
+}
+
+namespace {
+
+struct inline_depth_scope {
+    explicit inline_depth_scope(std::size_t depth) : saved(inline_continuation_depth()) {
+        set_inline_continuation_depth(depth);
+    }
+    ~inline_depth_scope() {
+        set_inline_continuation_depth(saved);
+    }
+    std::size_t saved;
+};
+
+// Keeps what is submitted to it until the test runs it.
+class holding_executor final : public Executor {
+public:
+    void post(task& t) override {
+        tasks.push_back(&t);
+    }
+
+    std::size_t run() {
+        auto pending = std::exchange(tasks, {});
+        for (auto* t : pending) {
+            t->run();
+        }
+        return pending.size();
+    }
+
+    std::vector<task*> tasks;
+};
+
+} // namespace
+
+TEST_CASE("Long then() chains do not grow the stack", "[future][trampoline]") {
+    constexpr int depth = 200000;
+    promise<int> p;
+    auto tail = p.get_future();
+    for (int i = 0; i < depth; ++i) {
+        tail = std::move(tail).then([](int v) { return v + 1; });
+    }
+    p.set_value(0);
+    REQUIRE(tail.get() == depth);
+}
+
+TEST_CASE("Nested future returns do not grow the stack", "[future][trampoline]") {
+    constexpr int depth = 100000;
+    std::vector<promise<int>> promises(depth + 1);
+    auto tail = promises[0].get_future();
+    for (int i = 0; i < depth; ++i) {
+        tail = std::move(tail).then([&promises, i](int v) {
+            auto next = promises[i + 1].get_future();
+            promises[i + 1].set_value(v + 1);
+            return next;
+        });
+    }
+    promises[0].set_value(0);
+    REQUIRE(tail.get() == depth);
+}
+
+TEST_CASE("Continuations beyond the inline depth run once the current one returns", "[future][trampoline]") {
+    std::vector<std::string> log;
+    auto run = [&log]() {
+        log.clear();
+        promise<int> a, b;
+        a.get_future().on_ready([&log, &b](expected<int, std::exception_ptr> const&) {
+            log.push_back("a");
+            b.set_value(1);
+            log.push_back("a done");
+        });
+        b.get_future().on_ready([&log](expected<int, std::exception_ptr> const&) { log.push_back("b"); });
+        a.set_value(1);
+        return log;
+    };
+
+    REQUIRE(run() == std::vector<std::string>{"a", "b", "a done"});
+
+    inline_depth_scope scope(1);
+    REQUIRE(run() == std::vector<std::string>{"a", "a done", "b"});
+}
+
+TEST_CASE("Deferred continuations may still take the value", "[future][trampoline][move]") {
+    inline_depth_scope scope(1);
+    promise<int> a;
+    promise<counted> b;
+    std::string seen;
+    a.get_future().on_ready([&b](expected<int, std::exception_ptr> const&) {
+        b.set_value(counted("blah"));
+    });
+    auto result = b.get_future().then([&seen](counted c) { seen = std::move(c.value); });
+
+    counted::copies = 0;
+    a.set_value(1);
+    REQUIRE(seen == "blah");
+    REQUIRE(counted::copies == 0);
+    result.get();
+}
+
+TEST_CASE("Continuations beyond the inline depth go to the current executor", "[future][trampoline][executor]") {
+    inline_depth_scope depth(1);
+    holding_executor executor;
+    std::vector<std::string> log;
+    {
+        executor_scope scope(executor);
+        promise<int> a, b;
+        a.get_future().on_ready([&log, &b](expected<int, std::exception_ptr> const&) {
+            b.set_value(1);
+            log.push_back("a done");
+        });
+        b.get_future().on_ready([&log](expected<int, std::exception_ptr> const&) { log.push_back("b"); });
+        a.set_value(1);
+        REQUIRE(log == std::vector<std::string>{"a done"});
+        REQUIRE(current_executor() == &executor);
+    }
+    REQUIRE(current_executor() == nullptr);
+    REQUIRE(executor.run() == 1);
+    REQUIRE(log == std::vector<std::string>{"a done", "b"});
+}
+
+TEST_CASE("Continuations are not deferred to an inline executor", "[future][trampoline][executor]") {
+    inline_depth_scope depth(1);
+    inline_executor executor;
+    executor_scope scope(executor);
+    REQUIRE(current_executor() == nullptr);
+
+    std::vector<std::string> log;
+    promise<int> a, b;
+    a.get_future().on_ready([&log, &b](expected<int, std::exception_ptr> const&) {
+        b.set_value(1);
+        log.push_back("a done");
+    });
+    b.get_future().on_ready([&log](expected<int, std::exception_ptr> const&) { log.push_back("b"); });
+    a.set_value(1);
+    REQUIRE(log == std::vector<std::string>{"a done", "b"});
+}
+
+TEST_CASE("Continuations queued by a dispatch that throws run with the next one", "[future][trampoline]") {
+    inline_depth_scope depth(1);
+    promise<int> a, b, c;
+    std::vector<std::string> log;
+    a.get_future().on_ready([&b](expected<int, std::exception_ptr> const&) {
+        b.set_value(1);
+        throw std::runtime_error("handler");
+    });
+    b.get_future().on_ready([&log](expected<int, std::exception_ptr> const&) { log.push_back("b"); });
+    c.get_future().on_ready([&log](expected<int, std::exception_ptr> const&) { log.push_back("c"); });
+    REQUIRE_THROWS_AS(a.set_value(1), std::runtime_error);
+    REQUIRE(log.empty());
+    c.set_value(1);
+    REQUIRE(log == std::vector<std::string>{"c", "b"});
+}
+
+TEST_CASE("Blocking on a deferred continuation runs it on the blocking thread", "[future][trampoline]") {
+    constexpr int depth = 1000;
+    promise<int> a, b;
+    auto tail = b.get_future();
+    for (int i = 0; i < depth; ++i) {
+        tail = std::move(tail).then([](int v) { return v + 1; });
+    }
+    int seen = 0;
+    a.get_future().on_ready([&b, &tail, &seen](expected<int, std::exception_ptr> const&) {
+        b.set_value(0);
+        seen = tail.get();
+    });
+    a.set_value(1);
+    REQUIRE(seen == depth);
+}
@@ -0,0 +1,150 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+#include "expected.hpp"
+#include "future.hpp"
+#include "optional.hpp"
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+enum class index_t : std::uint32_t {};
+enum class failure : std::uint8_t { timeout = 1, refused = 2 };
+
+struct node {
+    int v;
+};
+
+struct reason {
+    std::uint16_t code;
+    std::uint8_t retries;
+};
+
+} // namespace
+
+namespace hntr::platform {
+
+template <> struct niche<index_t> : sentinel_niche<index_t, index_t(~0u)> {};
+template <> struct niche<node*> : pointer_niche<node*> {};
+
+}
+
+using namespace hntr::platform;
+
+TEST_CASE("Types with a niche make optional the size of the payload", "[niche][optional]") {
+    STATIC_REQUIRE(sizeof(optional<node*>) == sizeof(node*));
+    STATIC_REQUIRE(sizeof(optional<index_t>) == sizeof(index_t));
+    STATIC_REQUIRE(std::is_trivially_copyable_v<optional<index_t>>);
+
+    // Nothing is opted in implicitly, pointers included.
+    STATIC_REQUIRE(sizeof(optional<int*>) > sizeof(int*));
+    STATIC_REQUIRE(sizeof(optional<int>) > sizeof(int));
+}
+
+TEST_CASE("Optional with a niche behaves like any optional", "[niche][optional]") {
+    node x{1};
+    optional<node*> p;
+    REQUIRE(!p);
+    p = &x;
+    REQUIRE(p);
+    REQUIRE(*p == &x);
+    optional<node*> null(static_cast<node*>(nullptr));
+    REQUIRE(null);
+    REQUIRE(*null == nullptr);
+    p.reset();
+    REQUIRE(!p);
+
+    constexpr optional<index_t> empty;
+    constexpr optional<index_t> seven(index_t(7));
+    STATIC_REQUIRE(!empty);
+    STATIC_REQUIRE(*seven == index_t(7));
+
+    std::vector<optional<index_t>> cache(4);
+    cache[2] = index_t(42);
+    REQUIRE(!cache[0]);
+    REQUIRE(cache[2].value() == index_t(42));
+}
+
+TEST_CASE("Optional without a niche assigns only what it holds", "[optional]") {
+    optional<std::string> a(std::string("value"));
+    optional<std::string> b;
+    optional<std::string> empty;
+
+    b = a;
+    REQUIRE(*b == "value");
+    b = empty;
+    REQUIRE(!b);
+    b = std::move(a);
+    REQUIRE(*b == "value");
+    auto& same = b;
+    b = same;
+    REQUIRE(*b == "value");
+
+    optional<std::string> c(std::string("moved"));
+    std::string taken = *std::move(c);
+    REQUIRE(taken == "moved");
+    b = std::string("again");
+    REQUIRE(std::move(b).value() == "again");
+}
+
+TEST_CASE("Opted-in pointers carry small errors in expected", "[niche][expected]") {
+    STATIC_REQUIRE(sizeof(expected<node*, failure>) == sizeof(node*));
+    STATIC_REQUIRE(sizeof(expected<node*, int>) == sizeof(node*));
+    STATIC_REQUIRE(sizeof(expected<node*, reason>) == sizeof(node*));
+    STATIC_REQUIRE(std::is_trivially_copyable_v<expected<node*, failure>>);
+
+    // Errors too wide to sit beside the tag, and pointers not opted in, keep
+    // the flag.
+    STATIC_REQUIRE(sizeof(expected<node*, std::intptr_t>) > sizeof(node*));
+    STATIC_REQUIRE(sizeof(expected<int*, failure>) > sizeof(int*));
+
+    node x{1};
+    expected<node*, failure> ok(&x);
+    REQUIRE(ok);
+    REQUIRE(*ok == &x);
+    REQUIRE((*ok)->v == 1);
+
+    expected<node*, failure> failed(unexpected(failure::refused));
+    REQUIRE(!failed);
+    REQUIRE(failed.error() == failure::refused);
+
+    expected<node*, int> negative(unexpected(-5));
+    REQUIRE(negative.error() == -5);
+    negative = unexpected(7);
+    REQUIRE(negative.error() == 7);
+    negative = expected<node*, int>(ok.value());
+    REQUIRE(*negative == &x);
+
+    REQUIRE(*expected<node*, int>() == nullptr);
+}
+
+TEST_CASE("Compact expected has the members of the generic one", "[niche][expected]") {
+    expected<node*, reason> r(unexpected(reason{503, 0}));
+    auto& e = r.error();
+    ++e.retries;
+    REQUIRE(r.error().retries == 1);
+    REQUIRE(r.error().code == 503);
+    REQUIRE(std::move(r).error().code == 503);
+
+    node x{2};
+    auto recovered = r.or_else([&x](reason const&) { return expected<node*, reason>(&x); });
+    REQUIRE(*recovered == &x);
+    REQUIRE(recovered.transform([](node* n) { return n->v; }).value() == 2);
+}
+
+TEST_CASE("Compact expected travels through futures", "[niche][future]") {
+    node x{1};
+    promise<node*, failure> p;
+    auto f = p.get_future().then([](node* v) { return v; });
+    p.set_value(&x);
+    REQUIRE(f.get() == &x);
+
+    promise<node*, failure> q;
+    auto g = q.get_future().then([](node* v) { return v; });
+    q.set_exception(failure::timeout);
+    REQUIRE(g.result().error() == failure::timeout);
+}
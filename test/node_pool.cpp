@@ -0,0 +1,90 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+#include "future.hpp"
+
+#include <array>
+#include <thread>
+#include <vector>
+
+using namespace hntr::platform;
+
+#if !defined(HNTR_PLATFORM_NODE_POOL)
+#error "node_pool tests must be built with HNTR_PLATFORM_NODE_POOL"
+#endif
+
+namespace {
+
+int run_chain(int hops) {
+    promise<int> p;
+    auto f = p.get_future();
+    for (int i = 0; i < hops; ++i) {
+        f = f.then([](int v) { return v + 1; });
+    }
+    p.set_value(0);
+    return f.get();
+}
+
+} // namespace
+
+TEST_CASE("Freed nodes are reused by the next allocation", "[node_pool]") {
+    auto* a = node_pool::allocate(40);
+    node_pool::deallocate(a, 40);
+    auto* b = node_pool::allocate(48);
+    REQUIRE(a == b);
+    node_pool::deallocate(b, 48);
+}
+
+TEST_CASE("Chain nodes are recycled", "[node_pool]") {
+    REQUIRE(run_chain(16) == 16);
+    const auto before = node_pool::stats();
+
+    for (int i = 0; i < 100; ++i) {
+        REQUIRE(run_chain(16) == 16);
+    }
+
+    const auto after = node_pool::stats();
+    REQUIRE(after.allocations - before.allocations == 100 * 17);
+    REQUIRE(after.cache_hits - before.cache_hits == 100 * 17);
+    REQUIRE(after.reserved_bytes == before.reserved_bytes);
+    REQUIRE(after.used_bytes() == before.used_bytes());
+    REQUIRE(after.hit_rate() > 0.0);
+}
+
+TEST_CASE("Nodes freed on another thread return to the pool", "[node_pool]") {
+    const auto before = node_pool::stats();
+
+    std::vector<promise<int>> promises(256);
+    std::vector<future<int, std::exception_ptr>> futures;
+    for (auto& p : promises) {
+        futures.push_back(p.get_future().then([](int v) { return v * 2; }));
+    }
+    REQUIRE(node_pool::stats().used_bytes() > before.used_bytes());
+
+    std::thread consumer([promises = std::move(promises), futures = std::move(futures)]() mutable {
+        for (auto& p : promises) {
+            p.set_value(1);
+        }
+        for (auto& f : futures) {
+            f.get();
+        }
+    });
+    consumer.join();
+
+    const auto after = node_pool::stats();
+    REQUIRE(after.used_bytes() == before.used_bytes());
+    REQUIRE(after.allocations - before.allocations == 512);
+}
+
+TEST_CASE("Nodes above the largest size class bypass the pool", "[node_pool]") {
+    const auto before = node_pool::stats();
+
+    std::array<char, node_pool::max_node_size> payload{};
+    promise<int> p;
+    auto f = p.get_future().then([payload](int v) { return v + payload[0]; });
+    p.set_value(1);
+    REQUIRE(f.get() == 1);
+
+    const auto after = node_pool::stats();
+    REQUIRE(after.oversized - before.oversized == 1);
+}
@@ -0,0 +1,156 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+#include "ready_queue.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+using namespace hntr::platform;
+
+namespace {
+
+bool readable(ready_queue const& q) {
+    pollfd p{q.fd(), POLLIN, 0};
+    return ::poll(&p, 1, 0) == 1;
+}
+
+std::vector<std::uint64_t> reap_all(ready_queue& q) {
+    std::vector<std::uint64_t> ids;
+    q.reap([&ids](std::uint64_t id) { ids.push_back(id); });
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+} // namespace
+
+TEST_CASE("Fulfilled futures are reaped by id", "[ready_queue]") {
+    ready_queue q;
+    std::vector<promise<int>> promises(4);
+    std::vector<future<int, std::exception_ptr>> futures;
+    for (std::uint64_t i = 0; i < promises.size(); ++i) {
+        futures.push_back(promises[i].get_future());
+        REQUIRE(q.watch(futures.back(), i));
+    }
+    REQUIRE(!readable(q));
+
+    promises[3].set_value(30);
+    promises[1].set_value(10);
+    REQUIRE(readable(q));
+    REQUIRE(reap_all(q) == std::vector<std::uint64_t>{1, 3});
+    REQUIRE(!readable(q));
+    REQUIRE(**futures[3].try_get() == 30);
+    REQUIRE(!futures[0].is_ready());
+
+    promises[0].set_value(0);
+    REQUIRE(reap_all(q) == std::vector<std::uint64_t>{0});
+    REQUIRE(reap_all(q).empty());
+}
+
+TEST_CASE("Fulfilments before a reap coalesce into one signal", "[ready_queue]") {
+    ready_queue q;
+    std::vector<promise<int>> promises(16);
+    for (std::uint64_t i = 0; i < promises.size(); ++i) {
+        auto f = promises[i].get_future();
+        q.watch(f, i);
+    }
+    for (auto& p : promises) {
+        p.set_value(1);
+    }
+
+    // One wake-up for all sixteen; reading it directly leaves the ids queued.
+    std::uint64_t count = 0;
+    REQUIRE(::read(q.fd(), &count, sizeof(count)) == sizeof(count));
+    REQUIRE(count == 1);
+    REQUIRE(reap_all(q).size() == 16);
+}
+
+TEST_CASE("Watching is refused beyond capacity", "[ready_queue]") {
+    ready_queue q(2);
+    promise<int> a, c, d;
+    auto fa = a.get_future(), fc = c.get_future(), fd = d.get_future();
+    auto b = std::make_unique<promise<int>>();
+    REQUIRE(q.watch(fa, 0));
+    {
+        auto fb = b->get_future();
+        REQUIRE(q.watch(fb, 1));
+    }
+    REQUIRE(!q.watch(fc, 2));
+
+    // Reaped futures and futures dropped without a value free their place.
+    a.set_value(1);
+    REQUIRE(reap_all(q).size() == 1);
+    REQUIRE(q.watch(fc, 2));
+    REQUIRE(!q.watch(fd, 3));
+    b.reset();
+    REQUIRE(q.watch(fd, 3));
+}
+
+TEST_CASE("Futures may outlive the queue watching them", "[ready_queue]") {
+    promise<int> p;
+    auto f = p.get_future();
+    {
+        ready_queue q;
+        q.watch(f, 7);
+    }
+    p.set_value(1);
+    REQUIRE(f.get() == 1);
+}
+
+TEST_CASE("An epoll loop reaps fulfilments from many threads", "[ready_queue][stress]") {
+    constexpr int threads = 4;
+    constexpr int per_thread = 1024;
+
+    ready_queue q(threads * per_thread);
+    std::vector<promise<int>> promises(threads * per_thread);
+    std::vector<future<int, std::exception_ptr>> futures;
+    for (std::uint64_t i = 0; i < promises.size(); ++i) {
+        futures.push_back(promises[i].get_future());
+        REQUIRE(q.watch(futures.back(), i));
+    }
+
+    const int ep = ::epoll_create1(EPOLL_CLOEXEC);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    REQUIRE(::epoll_ctl(ep, EPOLL_CTL_ADD, q.fd(), &ev) == 0);
+
+    std::vector<std::thread> producers;
+    for (int t = 0; t < threads; ++t) {
+        producers.emplace_back([&promises, t]() {
+            for (int i = t; i < threads * per_thread; i += threads) {
+                promises[i].set_value(i);
+            }
+        });
+    }
+
+    std::vector<int> seen(promises.size(), 0);
+    std::size_t reaped = 0;
+    int wakeups = 0;
+    while (reaped < promises.size()) {
+        epoll_event out;
+        if (::epoll_wait(ep, &out, 1, 1000) != 1) {
+            break;
+        }
+        ++wakeups;
+        reaped += q.reap([&](std::uint64_t id) {
+            ++seen[id];
+            REQUIRE(**futures[id].try_get() == static_cast<int>(id));
+        });
+    }
+    for (auto& p : producers) {
+        p.join();
+    }
+    ::close(ep);
+
+    REQUIRE(reaped == promises.size());
+    REQUIRE(std::all_of(seen.begin(), seen.end(), [](int n) { return n == 1; }));
+    REQUIRE(wakeups <= static_cast<int>(reaped));
+}
@@ -0,0 +1,125 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+#include "sender.hpp"
+#include "thread_pool.hpp"
+
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+
+using namespace hntr::platform;
+
+namespace {
+
+class queue_executor : public Executor {
+public:
+    void post(task& t) override {
+        _queue.push_back(&t);
+    }
+
+    std::size_t run() {
+        std::size_t count = 0;
+        while (!_queue.empty()) {
+            auto t = _queue.front();
+            _queue.pop_front();
+            t->run();
+            ++count;
+        }
+        return count;
+    }
+
+private:
+    std::deque<task*> _queue;
+};
+
+} // namespace
+
+TEST_CASE("Senders run when waited on", "[sender]") {
+    auto result = lazy::sync_wait(lazy::just(20)
+            .then([](int v) { return v + 1; })
+            .then([](int v) { return std::to_string(v * 2); }));
+    REQUIRE(*result == "42");
+}
+
+TEST_CASE("Senders do nothing until started", "[sender]") {
+    int runs = 0;
+    auto work = lazy::just(1).then([&runs](int v) { ++runs; return v; });
+    REQUIRE(runs == 0);
+    REQUIRE(*lazy::sync_wait(std::move(work)) == 1);
+    REQUIRE(runs == 1);
+}
+
+TEST_CASE("Sender stages may take and return void", "[sender]") {
+    int seen = 0;
+    auto result = lazy::sync_wait(lazy::just()
+            .then([&seen]() { seen = 1; })
+            .then([&seen]() { return seen + 1; }));
+    REQUIRE(*result == 2);
+}
+
+TEST_CASE("Exceptions skip the following sender stages", "[sender]") {
+    int runs = 0;
+    auto result = lazy::sync_wait(lazy::just(1)
+            .then([](int) -> int { throw std::logic_error("Custom error"); })
+            .then([&runs](int v) { ++runs; return v; }));
+    REQUIRE(!result);
+    CHECK_THROWS_AS(std::rethrow_exception(result.error()), std::logic_error);
+    REQUIRE(runs == 0);
+}
+
+TEST_CASE("Typed errors pass through sender stages", "[sender]") {
+    int runs = 0;
+    auto result = lazy::sync_wait(lazy::just_error<int>(std::make_error_code(std::errc::timed_out))
+            .then([&runs](int v) { ++runs; return v; }));
+    REQUIRE(!result);
+    REQUIRE(result.error() == std::errc::timed_out);
+    REQUIRE(runs == 0);
+}
+
+TEST_CASE("on() starts the work on the executor", "[sender]") {
+    queue_executor ex;
+    int seen = 0;
+    auto work = lazy::just(1).then([](int v) { return v + 1; }).on(ex)
+            .then([&seen](int v) { seen = v; });
+
+    auto future = lazy::as_future(std::move(work));
+    REQUIRE(seen == 0);
+    REQUIRE(ex.run() == 1);
+    REQUIRE(seen == 2);
+    future.get();
+}
+
+TEST_CASE("on() resumes on a pool thread", "[sender]") {
+    thread_pool pool(2);
+    const auto caller = std::this_thread::get_id();
+    auto result = lazy::sync_wait(lazy::just(1).on(pool)
+            .then([caller](int) { return std::this_thread::get_id() != caller; }));
+    REQUIRE(*result);
+}
+
+TEST_CASE("when_all joins senders of different types", "[sender][when_all]") {
+    thread_pool pool(2);
+    auto result = lazy::sync_wait(lazy::when_all(
+            lazy::just(1).on(pool),
+            lazy::just(std::string("blah")).on(pool),
+            lazy::just(2).then([](int) -> int { throw std::logic_error("Custom error"); })));
+
+    auto& [a, b, c] = *result;
+    REQUIRE(*a == 1);
+    REQUIRE(*b == "blah");
+    REQUIRE(!c);
+}
+
+TEST_CASE("Senders bridge to futures and back", "[sender][future]") {
+    promise<int> p;
+    auto future = lazy::as_future(lazy::from_future(p.get_future())
+            .then([](int v) { return v * 2; }))
+            .then([](int v) { return v + 1; });
+    REQUIRE(!future.get(std::chrono::milliseconds(0)));
+
+    p.set_value(20);
+    REQUIRE(future.get() == 41);
+}
@@ -0,0 +1,149 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+#include "shared_future.hpp"
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace hntr::platform;
+
+namespace {
+
+struct counted {
+    static inline int copies = 0;
+
+    counted() = default;
+    explicit counted(std::string v) : value(std::move(v)) {}
+    counted(counted const& o) : value(o.value) { ++copies; }
+    counted(counted&&) noexcept = default;
+    counted& operator= (counted const& o) { value = o.value; ++copies; return *this; }
+    counted& operator= (counted&&) noexcept = default;
+
+    std::string value;
+};
+
+} // namespace
+
+TEST_CASE("Every continuation sees the one stored value", "[shared_future]") {
+    promise<counted> p;
+    shared_future<counted> shared(p.get_future());
+
+    std::vector<counted const*> seen;
+    std::vector<future<std::size_t, std::exception_ptr>> lengths;
+    for (int i = 0; i < 8; ++i) {
+        lengths.push_back(shared.then([&seen](counted const& c) {
+            seen.push_back(&c);
+            return c.value.size();
+        }));
+    }
+
+    counted::copies = 0;
+    p.set_value(counted("blah"));
+
+    REQUIRE(counted::copies == 0);
+    REQUIRE(seen.size() == 8);
+    for (auto* c : seen) {
+        REQUIRE(c == &shared.get());
+    }
+    for (auto& l : lengths) {
+        REQUIRE(l.get() == 4);
+    }
+}
+
+TEST_CASE("Continuations run in the order they were attached", "[shared_future]") {
+    promise<int> p;
+    shared_future<int> shared(p.get_future());
+
+    std::vector<int> order;
+    for (int i = 0; i < 5; ++i) {
+        shared.on_ready([&order, i](expected<int, std::exception_ptr> const&) { order.push_back(i); });
+    }
+    p.set_value(1);
+    REQUIRE(order == std::vector<int>{0, 1, 2, 3, 4});
+}
+
+TEST_CASE("Continuations attached after fulfilment run immediately", "[shared_future]") {
+    promise<std::string> p;
+    p.set_value("blah");
+    shared_future<std::string> shared(p.get_future());
+
+    std::string seen;
+    shared.on_ready([&seen](expected<std::string, std::exception_ptr> const& r) { seen = *r; });
+    REQUIRE(seen == "blah");
+    REQUIRE(shared.then([](std::string const& s) { return s + "!"; }).get() == "blah!");
+}
+
+TEST_CASE("Errors are broadcast", "[shared_future]") {
+    promise<int> p;
+    shared_future<int> shared(p.get_future());
+    auto a = shared.then([](int v) { return v; });
+    auto b = shared.then([](int v) { return v; });
+    p.set_exception(std::logic_error("Custom error"));
+
+    CHECK_THROWS_AS(a.get(), std::logic_error);
+    CHECK_THROWS_AS(b.get(), std::logic_error);
+    CHECK_THROWS_AS(shared.get(), std::logic_error);
+}
+
+TEST_CASE("Continuations are released if no value ever arrives", "[shared_future]") {
+    auto capture = std::make_shared<int>(1);
+    {
+        promise<int> p;
+        shared_future<int> shared(p.get_future());
+        shared.then([capture](int v) { return v; });
+        shared.on_ready([capture](expected<int, std::exception_ptr> const&) {});
+        REQUIRE(capture.use_count() == 3);
+    }
+    REQUIRE(capture.use_count() == 1);
+}
+
+TEST_CASE("Continuations scheduled on an executor read the value in place", "[shared_future]") {
+    thread_pool pool(2);
+    promise<counted> p;
+    shared_future<counted> shared(p.get_future());
+
+    auto a = shared.then(pool, [](counted const& c) { return c.value + "a"; });
+    auto b = shared.then(pool, [](counted const& c) { return c.value + "b"; });
+
+    counted::copies = 0;
+    p.set_value(counted("blah"));
+    REQUIRE(a.get() == "blaha");
+    REQUIRE(b.get() == "blahb");
+    REQUIRE(counted::copies == 0);
+}
+
+TEST_CASE("Consumers attaching during fulfilment each run once", "[shared_future][stress]") {
+    constexpr int threads = 4;
+    constexpr int per_thread = 256;
+
+    for (int round = 0; round < 20; ++round) {
+        promise<int> p;
+        shared_future<int> shared(p.get_future());
+        std::atomic<int> runs{0};
+        std::atomic<bool> go{false};
+
+        std::vector<std::thread> consumers;
+        for (int t = 0; t < threads; ++t) {
+            consumers.emplace_back([&]() {
+                while (!go) {
+                    std::this_thread::yield();
+                }
+                for (int i = 0; i < per_thread; ++i) {
+                    shared.on_ready([&runs](expected<int, std::exception_ptr> const& r) { runs += *r; });
+                }
+            });
+        }
+        go = true;
+        p.set_value(1);
+        for (auto& c : consumers) {
+            c.join();
+        }
+        REQUIRE(runs == threads * per_thread);
+    }
+}
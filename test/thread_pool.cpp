@@ -0,0 +1,184 @@
+#define CATCH_CONFIG_MAIN 
+#include "catch.hpp"
+
+#include "future.hpp"
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace hntr::platform;
+
+TEST_CASE("Deque pops in LIFO order and steals in FIFO order", "[thread_pool][deque]") {
+    struct noop : task { void run() override {} };
+    std::vector<noop> tasks(4);
+
+    details::work_stealing_deque deque(2);
+    for (auto& t : tasks) {
+        deque.push(&t);
+    }
+
+    REQUIRE(deque.steal() == &tasks[0]);
+    REQUIRE(deque.pop() == &tasks[3]);
+    REQUIRE(deque.steal() == &tasks[1]);
+    REQUIRE(deque.pop() == &tasks[2]);
+    REQUIRE(deque.pop() == nullptr);
+    REQUIRE(deque.steal() == nullptr);
+    REQUIRE(deque.empty());
+}
+
+TEST_CASE("Concurrent steals take every task exactly once", "[thread_pool][deque][stress]") {
+    struct counted : task {
+        std::atomic<int> runs{0};
+        void run() override { ++runs; }
+    };
+    constexpr int count = 100000;
+    std::vector<counted> tasks(count);
+    details::work_stealing_deque deque;
+
+    std::atomic<bool> done{false};
+    std::vector<std::thread> thieves;
+    for (int i = 0; i < 3; ++i) {
+        thieves.emplace_back([&]() {
+            while (!done.load() || !deque.empty()) {
+                if (auto t = deque.steal()) {
+                    t->run();
+                }
+            }
+        });
+    }
+
+    for (int i = 0; i < count; ++i) {
+        deque.push(&tasks[i]);
+        if (i % 3 == 0) {
+            if (auto t = deque.pop()) {
+                t->run();
+            }
+        }
+    }
+    while (auto t = deque.pop()) {
+        t->run();
+    }
+    done = true;
+    for (auto& t : thieves) {
+        t.join();
+    }
+
+    for (auto& t : tasks) {
+        REQUIRE(t.runs == 1);
+    }
+}
+
+TEST_CASE("Pool runs everything submitted before destruction", "[thread_pool]") {
+    std::atomic<int> runs{0};
+    {
+        thread_pool pool(4);
+        for (int i = 0; i < 1000; ++i) {
+            post(pool, [&runs]() { ++runs; });
+        }
+    }
+    REQUIRE(runs == 1000);
+}
+
+TEST_CASE("Work posted from a worker runs on the pool", "[thread_pool]") {
+    std::atomic<int> runs{0};
+    {
+        thread_pool pool(2);
+        post(pool, [&]() {
+            for (int i = 0; i < 100; ++i) {
+                post(pool, [&]() {
+                    if (pool.running_in_this_thread()) {
+                        ++runs;
+                    }
+                });
+            }
+        });
+    }
+    REQUIRE(runs == 100);
+}
+
+TEST_CASE("Deferred work stays on the submitting worker", "[thread_pool]") {
+    thread_pool pool(4);
+    promise<std::thread::id> p;
+    post(pool, [&]() {
+        auto id = std::this_thread::get_id();
+        defer(pool, [&p, id]() {
+            p.set_value(id == std::this_thread::get_id() ? id : std::thread::id());
+        });
+    });
+    REQUIRE(p.get_future().get() != std::thread::id());
+}
+
+TEST_CASE("Idle workers steal from a blocked worker", "[thread_pool]") {
+    thread_pool pool(4);
+    std::atomic<int> runs{0};
+    std::mutex ids_mutex;
+    std::set<std::thread::id> ids;
+    promise<int> done;
+
+    post(pool, [&]() {
+        auto owner = std::this_thread::get_id();
+        for (int i = 0; i < 64; ++i) {
+            post(pool, [&]() {
+                {
+                    std::lock_guard lock(ids_mutex);
+                    ids.insert(std::this_thread::get_id());
+                }
+                ++runs;
+            });
+        }
+        // Everything queued above sits in this worker's deque; it can only
+        // complete if other workers steal it.
+        while (runs < 64) {
+            std::this_thread::yield();
+        }
+        std::lock_guard lock(ids_mutex);
+        done.set_value(static_cast<int>(ids.count(owner)));
+    });
+
+    REQUIRE(done.get_future().get() == 0);
+    REQUIRE(runs == 64);
+}
+
+TEST_CASE("Deferred work is not stranded behind a blocked worker", "[thread_pool]") {
+    thread_pool pool(2);
+    std::atomic<bool> ran{false};
+    promise<bool> done;
+
+    post(pool, [&]() {
+        defer(pool, [&ran]() { ran = true; });
+        // The deferred task sits in this worker's LIFO slot; it can only run
+        // if the other worker takes it from there.
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!ran && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+        done.set_value(ran.load());
+    });
+
+    REQUIRE(done.get_future().get());
+}
+
+TEST_CASE("Future chains run on the pool", "[thread_pool][future]") {
+    thread_pool pool(4);
+    std::vector<future<int, std::exception_ptr>> results;
+    std::vector<promise<int>> promises(16);
+
+    for (auto& p : promises) {
+        results.push_back(p.get_future().via(pool)
+                .then([](int v) { return v + 1; })
+                .then([&pool](int v) {
+                    return pool.running_in_this_thread() ? v * 2 : -1;
+                }));
+    }
+    for (std::size_t i = 0; i < promises.size(); ++i) {
+        promises[i].set_value(static_cast<int>(i));
+    }
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        REQUIRE(results[i].get() == static_cast<int>(i + 1) * 2);
+    }
+}
@@ -0,0 +1,102 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+#include "future.hpp"
+#include "ready_queue.hpp"
+#include "sender.hpp"
+
+#include <cstdint>
+#include <string>
+#include <system_error>
+
+using namespace hntr::platform;
+
+#if defined(__cpp_exceptions)
+#error "typed_error tests must be built with -fno-exceptions"
+#endif
+
+namespace {
+
+enum class failure { none, timeout, refused };
+
+expected<int, std::error_code> checked(int v) {
+    if (v < 0) {
+        return unexpected(std::make_error_code(std::errc::invalid_argument));
+    }
+    return expected<int, std::error_code>(v);
+}
+
+} // namespace
+
+TEST_CASE("Typed errors skip the rest of the chain", "[typed_error]") {
+    promise<int, std::error_code> p;
+    int runs = 0;
+    auto result = p.get_future()
+            .then([&runs](int v) { ++runs; return v + 1; })
+            .then([&runs](int v) { ++runs; return v + 1; });
+    p.set_exception(std::make_error_code(std::errc::timed_out));
+
+    REQUIRE(!result.result());
+    REQUIRE(result.result().error() == std::errc::timed_out);
+    REQUIRE(runs == 0);
+}
+
+TEST_CASE("Handlers fail by returning an expected", "[typed_error]") {
+    promise<int, std::error_code> p;
+    int runs = 0;
+    auto result = p.get_future()
+            .then(checked)
+            .then([&runs](int v) { ++runs; return std::to_string(v); });
+    p.set_value(-1);
+
+    REQUIRE(result.result().error() == std::errc::invalid_argument);
+    REQUIRE(runs == 0);
+}
+
+TEST_CASE("Values pass through typed chains", "[typed_error]") {
+    promise<int, std::error_code> p;
+    auto result = p.get_future()
+            .then(checked)
+            .then([](int v) { return v * 2; });
+    p.set_value(21);
+    REQUIRE(result.get() == 42);
+}
+
+TEST_CASE("Small enums work as the error type", "[typed_error]") {
+    promise<int, failure> p;
+    failure seen = failure::none;
+    p.get_future()
+            .then([](int v) -> expected<int, failure> {
+                return v > 10 ? expected<int, failure>(unexpected(failure::refused)) : expected<int, failure>(v);
+            })
+            .on_ready([&seen](expected<int, failure> const& r) {
+                seen = r ? failure::none : r.error();
+            });
+    p.set_value(11);
+    REQUIRE(seen == failure::refused);
+}
+
+TEST_CASE("Typed errors pass through pipelines and senders", "[typed_error]") {
+    promise<int, std::error_code> p;
+    future<int, std::error_code> fused = p.get_future().pipe()
+            .then(checked)
+            .then([](int v) { return v + 1; });
+    p.set_value(-5);
+    REQUIRE(fused.result().error() == std::errc::invalid_argument);
+
+    auto result = lazy::sync_wait(lazy::just<std::error_code>(7).then(checked));
+    REQUIRE(*result == 7);
+}
+
+TEST_CASE("ready_queue reaps typed futures", "[typed_error][ready_queue]") {
+    ready_queue q;
+    promise<int, failure> p;
+    auto f = p.get_future();
+    REQUIRE(q.watch(f, 7));
+    p.set_exception(failure::timeout);
+
+    std::uint64_t reaped = 0;
+    REQUIRE(q.reap([&reaped](std::uint64_t id) { reaped = id; }) == 1);
+    REQUIRE(reaped == 7);
+    REQUIRE(f.result().error() == failure::timeout);
+}
@@ -0,0 +1,320 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+#include "when_all.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace hntr::platform;
+
+namespace {
+
+struct refusal {
+    explicit refusal(int c) : code(c) {}
+    int code;
+};
+
+struct counted {
+    static inline int copies = 0;
+
+    counted() = default;
+    explicit counted(std::string v) : value(std::move(v)) {}
+    counted(counted const& o) : value(o.value) { ++copies; }
+    counted(counted&&) noexcept = default;
+    counted& operator= (counted const& o) { value = o.value; ++copies; return *this; }
+    counted& operator= (counted&&) noexcept = default;
+
+    std::string value;
+};
+
+future<counted, std::exception_ptr> fulfilled(std::string v) {
+    promise<counted> p;
+    p.set_value(counted(std::move(v)));
+    return p.get_future();
+}
+
+} // namespace
+
+TEST_CASE("when_all joins futures of different types", "[when_all]") {
+    promise<int> a;
+    promise<std::string> b;
+
+    auto joined = when_all(a.get_future(), b.get_future());
+    REQUIRE(!joined.get(std::chrono::milliseconds(0)));
+
+    b.set_value("blah");
+    REQUIRE(!joined.get(std::chrono::milliseconds(0)));
+    a.set_value(33);
+
+    auto& [x, y] = joined.get();
+    REQUIRE(*x == 33);
+    REQUIRE(*y == "blah");
+}
+
+TEST_CASE("when_all keeps inputs of the same type apart", "[when_all]") {
+    promise<int> a;
+    promise<int> b;
+    auto joined = when_all(a.get_future(), b.get_future());
+    b.set_value(2);
+    a.set_value(1);
+    REQUIRE(*std::get<0>(joined.get()) == 1);
+    REQUIRE(*std::get<1>(joined.get()) == 2);
+}
+
+TEST_CASE("when_all reports errors per element", "[when_all]") {
+    promise<int> a;
+    promise<int> b;
+    a.set_exception(std::logic_error("Custom error"));
+    b.set_value(1);
+
+    auto joined = when_all(a.get_future(), b.get_future());
+    auto& [x, y] = joined.get();
+    REQUIRE(!x);
+    CHECK_THROWS_AS(std::rethrow_exception(x.error()), std::logic_error);
+    REQUIRE(*y == 1);
+}
+
+TEST_CASE("when_all over a range keeps the order of the range", "[when_all]") {
+    std::vector<promise<int>> promises(16);
+    std::vector<future<int, std::exception_ptr>> futures;
+    for (auto& p : promises) {
+        futures.push_back(p.get_future());
+    }
+    auto joined = when_all(futures);
+
+    for (int i = 15; i >= 0; --i) {
+        promises[i].set_value(i * 10);
+    }
+
+    auto& results = joined.get();
+    REQUIRE(results.size() == 16);
+    for (int i = 0; i < 16; ++i) {
+        REQUIRE(*results[i] == i * 10);
+    }
+}
+
+TEST_CASE("when_all over an empty range completes immediately", "[when_all]") {
+    std::vector<future<int, std::exception_ptr>> futures;
+    REQUIRE(when_all(futures).get().empty());
+}
+
+TEST_CASE("Joins take error types without a default constructor", "[when_all][when_n]") {
+    promise<int, refusal> a;
+    promise<std::string, refusal> b;
+    auto both = when_all(a.get_future(), b.get_future());
+    b.set_exception(refusal(7));
+    a.set_value(1);
+    auto& [x, y] = both.get();
+    REQUIRE(*x == 1);
+    REQUIRE(y.error().code == 7);
+
+    std::vector<promise<int, refusal>> promises(3);
+    std::vector<promise<int, refusal>> mirrors(3);
+    std::vector<future<int, refusal>> futures;
+    std::vector<future<int, refusal>> mirror_futures;
+    for (int i = 0; i < 3; ++i) {
+        futures.push_back(promises[i].get_future());
+        mirror_futures.push_back(mirrors[i].get_future());
+    }
+    auto all = when_all(futures);
+    auto first = when_n(2, mirror_futures);
+    for (int i : {2, 0, 1}) {
+        if (i == 0) {
+            promises[i].set_exception(refusal(0));
+            mirrors[i].set_exception(refusal(0));
+        } else {
+            promises[i].set_value(i);
+            mirrors[i].set_value(i);
+        }
+    }
+
+    REQUIRE(all.get().size() == 3);
+    REQUIRE(all.get()[0].error().code == 0);
+    REQUIRE(*all.get()[1] == 1);
+    REQUIRE(first.get().size() == 2);
+    REQUIRE(first.get()[0].index == 2);
+    REQUIRE(first.get()[1].value.error().code == 0);
+}
+
+TEST_CASE("Joins move the values of inputs they are given", "[when_all][move]") {
+    counted::copies = 0;
+    auto both = when_all(fulfilled("a"), fulfilled("b"));
+    REQUIRE(std::get<1>(both.get()).value().value == "b");
+    REQUIRE(counted::copies == 0);
+
+    std::vector<future<counted, std::exception_ptr>> given;
+    given.push_back(fulfilled("c"));
+    given.push_back(fulfilled("d"));
+    auto all = when_all(std::move(given));
+    REQUIRE(all.get()[1].value().value == "d");
+    REQUIRE(counted::copies == 0);
+
+    std::vector<future<counted, std::exception_ptr>> kept;
+    kept.push_back(fulfilled("e"));
+    auto copied = when_all(kept);
+    REQUIRE(copied.get()[0].value().value == "e");
+    REQUIRE(kept[0].get().value == "e");
+    REQUIRE(counted::copies == 1);
+}
+
+TEST_CASE("when_all_columns gathers a range into columns", "[when_all][expected_array]") {
+    std::vector<promise<int>> promises(100);
+    std::vector<future<int, std::exception_ptr>> futures;
+    for (auto& p : promises) {
+        futures.push_back(p.get_future());
+    }
+    auto joined = when_all_columns(futures);
+
+    for (int i = 99; i >= 0; --i) {
+        if (i % 10 == 0) {
+            promises[i].set_exception(std::logic_error("Custom error"));
+        } else {
+            promises[i].set_value(i);
+        }
+    }
+
+    auto& results = joined.get();
+    REQUIRE(results.size() == 100);
+    REQUIRE(results.count_errors() == 10);
+    REQUIRE(results.value(7) == 7);
+    CHECK_THROWS_AS(std::rethrow_exception(results.error(20)), std::logic_error);
+    REQUIRE(results.successes().size() == 90);
+
+    std::vector<future<int, std::exception_ptr>> none;
+    REQUIRE(when_all_columns(none).get().size() == 0);
+}
+
+TEST_CASE("when_all is thenable", "[when_all]") {
+    std::vector<promise<int>> promises(3);
+    std::vector<future<int, std::exception_ptr>> futures;
+    for (auto& p : promises) {
+        futures.push_back(p.get_future());
+    }
+
+    auto sum = when_all(futures).then([](std::vector<expected<int, std::exception_ptr>> const& results) {
+        int s = 0;
+        for (auto& r : results) {
+            s += *r;
+        }
+        return s;
+    });
+    promises[0].set_value(1);
+    promises[1].set_value(2);
+    promises[2].set_value(3);
+    REQUIRE(sum.get() == 6);
+}
+
+TEST_CASE("when_any completes with the first input", "[when_any]") {
+    std::vector<promise<int>> promises(4);
+    std::vector<future<int, std::exception_ptr>> futures;
+    for (auto& p : promises) {
+        futures.push_back(p.get_future());
+    }
+    auto first = when_any(futures);
+
+    promises[2].set_value(22);
+    promises[0].set_value(0);
+
+    auto& result = first.get();
+    REQUIRE(result.index == 2);
+    REQUIRE(*result.value == 22);
+
+    promises[1].set_value(11);
+    promises[3].set_value(33);
+}
+
+TEST_CASE("when_any outlives inputs that never arrive", "[when_any]") {
+    future<when_any_result<int, std::exception_ptr>, std::exception_ptr> first;
+    {
+        std::vector<promise<int>> promises(2);
+        std::vector<future<int, std::exception_ptr>> futures;
+        for (auto& p : promises) {
+            futures.push_back(p.get_future());
+        }
+        first = when_any(futures);
+        promises[1].set_value(1);
+    }
+    REQUIRE(first.get().index == 1);
+}
+
+TEST_CASE("when_n completes with the first n inputs in arrival order", "[when_n]") {
+    std::vector<promise<int>> promises(5);
+    std::vector<future<int, std::exception_ptr>> futures;
+    for (auto& p : promises) {
+        futures.push_back(p.get_future());
+    }
+    auto some = when_n(3, futures);
+
+    promises[4].set_value(4);
+    promises[1].set_exception(std::logic_error("Custom error"));
+    REQUIRE(!some.get(std::chrono::milliseconds(0)));
+    promises[3].set_value(3);
+
+    auto& results = some.get();
+    REQUIRE(results.size() == 3);
+    REQUIRE(results[0].index == 4);
+    REQUIRE(*results[0].value == 4);
+    REQUIRE(results[1].index == 1);
+    REQUIRE(!results[1].value);
+    REQUIRE(results[2].index == 3);
+
+    promises[0].set_value(0);
+    promises[2].set_value(2);
+}
+
+TEST_CASE("Joins complete once across producer threads", "[when_all][when_n]") {
+    constexpr int inputs = 64;
+    std::vector<promise<int>> promises(inputs);
+    std::vector<future<int, std::exception_ptr>> all_futures;
+    std::vector<future<int, std::exception_ptr>> some_futures;
+    std::vector<promise<int>> mirrors(inputs);
+    for (int i = 0; i < inputs; ++i) {
+        all_futures.push_back(promises[i].get_future());
+        some_futures.push_back(mirrors[i].get_future());
+    }
+    std::vector<promise<int>> columns(inputs);
+    std::vector<future<int, std::exception_ptr>> column_futures;
+    for (auto& p : columns) {
+        column_futures.push_back(p.get_future());
+    }
+    auto all = when_all(all_futures);
+    auto some = when_n(inputs / 2, some_futures);
+    auto columnar = when_all_columns(column_futures);
+
+    std::vector<std::thread> producers;
+    for (int t = 0; t < 4; ++t) {
+        producers.emplace_back([&, t]() {
+            for (int i = t; i < inputs; i += 4) {
+                promises[i].set_value(i);
+                mirrors[i].set_value(i);
+                columns[i].set_value(i);
+            }
+        });
+    }
+    for (auto& p : producers) {
+        p.join();
+    }
+
+    auto& results = all.get();
+    for (int i = 0; i < inputs; ++i) {
+        REQUIRE(*results[i] == i);
+    }
+
+    std::vector<bool> seen(inputs);
+    for (auto& r : some.get()) {
+        REQUIRE(*r.value == static_cast<int>(r.index));
+        REQUIRE(!seen[r.index]);
+        seen[r.index] = true;
+    }
+    REQUIRE(some.get().size() == inputs / 2);
+
+    auto& column = columnar.get();
+    REQUIRE(column.count_values() == inputs);
+    for (int i = 0; i < inputs; ++i) {
+        REQUIRE(column.value(i) == i);
+    }
+}